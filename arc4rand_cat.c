@@ -0,0 +1,361 @@
+/* vim: expandtab:tw=68:ts=4:sw=4:
+ *
+ * arc4rand_cat.c - Stream arc4random keystream to stdout or a file
+ *
+ * Copyright (c) 2015 Sudhi Herle <sw at herle.net>
+ *
+ * Licensing Terms: GPLv2
+ *
+ * If you need a commercial license for this work, please contact
+ * the author.
+ *
+ * This software does not come with any express or implied
+ * warranty; it is provided "as is". No claim  is made to its
+ * suitability for any purpose.
+ */
+
+/*
+ * Every worker thread fills its own page aligned buffer from its
+ * own (per-thread) arc4random state; output is serialized by a
+ * mutex. Random data has no order, so chunks go out in whatever
+ * order the workers finish them.
+ *
+ * On Linux:
+ *
+ *  - pipes are grown to the buffer size so that each chunk is one
+ *    write(2). vmsplice(2) isn't used: buffers would have to be
+ *    gifted and never reused (a reader may splice() our pages
+ *    onward), and a fresh mapping per chunk costs more in faults and
+ *    zero-fill than the copy it saves.
+ *
+ *  - files are opened with O_DIRECT (when the filesystem supports
+ *    it) to keep the page cache out of the way; the final partial
+ *    chunk is written with O_DIRECT turned off.
+ */
+
+#define _GNU_SOURCE 1
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "arc4random.h"
+#include "wipe.h"
+
+
+extern void error(int doexit, int err, const char* fmt, ...);
+
+
+#define BUFSZ_DEFAULT   (1024 * 1024)
+
+enum out_mode
+{
+    OUT_WRITE = 0,
+    OUT_DIRECT,
+};
+
+struct stream
+{
+    pthread_mutex_t lock;
+
+    int             fd;
+    enum out_mode   mode;
+    size_t          bufsz;
+
+    uint64_t        limit;      /* total bytes; 0 => unlimited */
+    uint64_t        rate;       /* bytes/sec; 0 => unlimited */
+    uint64_t        written;
+    uint64_t        t0;         /* start time in ns */
+    int             done;
+};
+
+
+static const char* Z = "arc4rand-cat";
+
+static void
+usage(int ex)
+{
+    fprintf(ex ? stderr : stdout,
+"Usage: %s [options]\n"
+"\n"
+"Write arc4random keystream to stdout (or a file) at memory bandwidth.\n"
+"\n"
+"Options:\n"
+"  -n SIZE    Stop after SIZE bytes [unlimited]\n"
+"  -r RATE    Limit output to RATE bytes/sec [unlimited]\n"
+"  -t N       Use N generator threads [online CPUs]\n"
+"  -b SIZE    Buffer size per write [1M]; for pipes this is the\n"
+"             pipe capacity\n"
+"  -o FILE    Write to FILE instead of stdout\n"
+"  -v         Print bytes written and throughput to stderr\n"
+"  -h         Show this help and exit\n"
+"\n"
+"SIZE and RATE take an optional k, M, G or T suffix (powers of 1024).\n",
+        Z);
+
+    exit(ex);
+}
+
+
+static uint64_t
+parse_size(const char* s, const char* what)
+{
+    char* end = 0;
+    unsigned long long v;
+
+    errno = 0;
+    v = strtoull(s, &end, 0);
+    if (errno || end == s)
+        error(1, 0, "%s: invalid %s '%s'\n", Z, what, s);
+
+    switch (*end) {
+    case 't': case 'T': v <<= 10; /* fallthrough */
+    case 'g': case 'G': v <<= 10; /* fallthrough */
+    case 'm': case 'M': v <<= 10; /* fallthrough */
+    case 'k': case 'K': v <<= 10; end++; break;
+    case 0:             break;
+    default:
+        error(1, 0, "%s: invalid %s '%s'\n", Z, what, s);
+    }
+
+    if (*end)
+        error(1, 0, "%s: invalid %s '%s'\n", Z, what, s);
+
+    return v;
+}
+
+
+static uint64_t
+now_ns()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+
+/*
+ * Sleep until writing 'n' more bytes keeps us at or under the rate
+ * limit.
+ */
+static void
+throttle(struct stream* s, size_t n)
+{
+    uint64_t due = s->t0 + (uint64_t)((double)(s->written + n) * 1e9 / (double)s->rate);
+    uint64_t now = now_ns();
+
+    if (due > now) {
+        struct timespec ts;
+        uint64_t d = due - now;
+
+        ts.tv_sec  = d / 1000000000;
+        ts.tv_nsec = d % 1000000000;
+        while (nanosleep(&ts, &ts) < 0 && errno == EINTR)
+            ;
+    }
+}
+
+
+static void
+out_write(struct stream* s, const uint8_t* b, size_t n)
+{
+#if defined(__linux__)
+    if (s->mode == OUT_DIRECT && n < s->bufsz) {
+        /* O_DIRECT needs block multiples; the tail goes out buffered */
+        int fl = fcntl(s->fd, F_GETFL);
+        fcntl(s->fd, F_SETFL, fl & ~O_DIRECT);
+        s->mode = OUT_WRITE;
+    }
+#endif
+
+    while (n > 0) {
+        ssize_t m = write(s->fd, b, n);
+
+        if (m < 0) {
+            if (errno == EINTR) continue;
+            error(1, errno, "%s: write failed", Z);
+        }
+        b += m;
+        n -= m;
+    }
+}
+
+
+static void*
+worker(void* arg)
+{
+    struct stream* s = (struct stream*)arg;
+    long pgsz = sysconf(_SC_PAGESIZE);
+    uint8_t* buf = 0;
+    int r;
+
+    r = posix_memalign((void**)&buf, pgsz, s->bufsz);
+    if (r != 0) error(1, r, "%s: can't allocate %lu byte buffer", Z, s->bufsz);
+
+    for (;;) {
+        size_t n = s->bufsz;
+
+        arc4random_buf(buf, n);
+
+        pthread_mutex_lock(&s->lock);
+        if (s->done) {
+            pthread_mutex_unlock(&s->lock);
+            break;
+        }
+
+        if (s->limit) {
+            uint64_t left = s->limit - s->written;
+            if (left < n) n = (size_t)left;
+        }
+
+        if (s->rate) throttle(s, n);
+
+        out_write(s, buf, n);
+        s->written += n;
+        if (s->limit && s->written >= s->limit)
+            s->done = 1;
+        pthread_mutex_unlock(&s->lock);
+    }
+
+    /* don't leave keystream lying around */
+    wipe(buf, s->bufsz);
+    free(buf);
+
+    return 0;
+}
+
+
+/*
+ * Pick the output strategy for 's->fd' and settle the buffer size.
+ */
+static void
+out_setup(struct stream* s, const char* file)
+{
+    long pgsz = sysconf(_SC_PAGESIZE);
+    struct stat st;
+
+    s->bufsz = (s->bufsz + pgsz - 1) & ~(size_t)(pgsz - 1);
+    s->mode  = OUT_WRITE;
+
+    if (file) {
+#if defined(__linux__)
+        s->fd = open(file, O_WRONLY|O_CREAT|O_TRUNC|O_DIRECT, 0600);
+        if (s->fd >= 0) {
+            s->mode = OUT_DIRECT;
+            return;
+        }
+        if (errno != EINVAL)
+            error(1, errno, "%s: can't create %s", Z, file);
+#endif
+        s->fd = open(file, O_WRONLY|O_CREAT|O_TRUNC, 0600);
+        if (s->fd < 0) error(1, errno, "%s: can't create %s", Z, file);
+        return;
+    }
+
+    s->fd = 1;
+    if (fstat(s->fd, &st) < 0) error(1, errno, "%s: can't stat stdout", Z);
+
+#if defined(__linux__)
+    if (S_ISFIFO(st.st_mode)) {
+        int psz;
+
+        /* the pipe may refuse sizes above /proc/sys/fs/pipe-max-size */
+        fcntl(s->fd, F_SETPIPE_SZ, (int)s->bufsz);
+        psz = fcntl(s->fd, F_GETPIPE_SZ);
+        if (psz > 0)
+            s->bufsz = (size_t)psz;
+    }
+#endif
+}
+
+
+int
+main(int argc, char* const* argv)
+{
+    struct stream s;
+    const char* file = 0;
+    long nthr = sysconf(_SC_NPROCESSORS_ONLN);
+    int verbose = 0;
+    enum out_mode mode;
+    pthread_t* tid;
+    long i;
+    int c;
+
+    memset(&s, 0, sizeof s);
+    pthread_mutex_init(&s.lock, 0);
+    s.bufsz = BUFSZ_DEFAULT;
+
+    while ((c = getopt(argc, argv, "n:r:t:b:o:vh")) != -1) {
+        switch (c) {
+        case 'n':
+            s.limit = parse_size(optarg, "size");
+            if (s.limit == 0) return 0;
+            break;
+        case 'r':
+            s.rate = parse_size(optarg, "rate");
+            break;
+        case 't':
+            nthr = atol(optarg);
+            if (nthr <= 0) error(1, 0, "%s: invalid thread count '%s'\n", Z, optarg);
+            break;
+        case 'b':
+            s.bufsz = (size_t)parse_size(optarg, "buffer size");
+            if (s.bufsz == 0) error(1, 0, "%s: invalid buffer size '%s'\n", Z, optarg);
+            break;
+        case 'o':
+            file = optarg;
+            break;
+        case 'v':
+            verbose = 1;
+            break;
+        case 'h':
+            usage(0);
+        default:
+            usage(1);
+        }
+    }
+
+    if (optind != argc) usage(1);
+    if (nthr <= 0) nthr = 1;
+
+    out_setup(&s, file);
+    mode = s.mode;
+
+    if (!(tid = (pthread_t*)calloc(nthr, sizeof *tid)))
+        error(1, errno, "%s: out of memory", Z);
+
+    s.t0 = now_ns();
+    for (i = 0; i < nthr; i++) {
+        int r = pthread_create(&tid[i], 0, worker, &s);
+        if (r != 0) error(1, r, "%s: can't create thread", Z);
+    }
+    for (i = 0; i < nthr; i++)
+        pthread_join(tid[i], 0);
+
+    if (file && close(s.fd) < 0)
+        error(1, errno, "%s: error closing %s", Z, file);
+
+    if (verbose) {
+        double secs = (double)(now_ns() - s.t0) / 1e9;
+        static const char* modes[] = { "write", "O_DIRECT" };
+
+        fprintf(stderr, "%s: %llu bytes in %.3f s, %.1f MiB/s (%ld threads, %lu byte buffers, %s)\n",
+                Z, (unsigned long long)s.written, secs,
+                (double)s.written / secs / (1024.0 * 1024.0),
+                nthr, s.bufsz, modes[mode]);
+    }
+
+    free(tid);
+    return 0;
+}
+
+/* EOF */
@@ -25,6 +25,7 @@
  * Made fully portable and thread-safe by Sudhi Herle.
  */
 
+#include <errno.h>
 #include <fcntl.h>
 #include <limits.h>
 #include <signal.h>
@@ -53,6 +54,12 @@ struct rand_state
     size_t          rs_have;    /* valid bytes at end of rs_buf */
     size_t          rs_count;   /* bytes till reseed */
     pid_t           rs_pid;     /* My PID */
+    uint64_t        rs_bits;    /* bit reservoir for sub-word draws */
+    size_t          rs_nbits;   /* valid bits in rs_bits */
+#ifdef ARC4RANDOM_STATS
+    uint64_t        rs_nrefill; /* rs_buf refills */
+    uint64_t        rs_nstir;   /* reseeds from getentropy() */
+#endif
     chacha_ctx      rs_chacha;  /* chacha context for random keystream */
     u_char          rs_buf[ARC4R_RSBUFSZ];  /* keystream blocks */
 };
@@ -66,10 +73,62 @@ extern int getentropy(void* buf, size_t n);
 #define KEYSTREAM_ONLY
 #include "chacha_private.h"
 
-#define minimum(a, b) ((a) < (b) ? (a) : (b))
+/*
+ * Keystream kernel. rs_buf is refilled 16 blocks at a time, so the
+ * multi-block NEON kernel never falls back to the scalar code.
+ */
+#if defined(__aarch64__) && defined(__ARM_NEON) && !defined(__AARCH64EB__)
+#include "chacha_neon.h"
+#define chacha_keystream    chacha_encrypt_bytes_neon
+#else
+#define chacha_keystream    chacha_encrypt_bytes
+#endif
 
 #include "arc4random.h"
 
+#define minimum(a, b) ((a) < (b) ? (a) : (b))
+
+#if defined(__GNUC__)
+#define prefetchw(p)    __builtin_prefetch((p), 1)
+#else
+#define prefetchw(p)    ((void)(p))
+#endif
+
+/* Shuffle draws and prefetches this many swap targets at a time */
+#define SHUFFLE_BATCH   16
+
+/*
+ * Sampling cost model, in timer ticks: a selection scan costs
+ * SAMPLE_SCAN per element of the range and Floyd's algorithm
+ * SAMPLE_FLOYD_HOT per sample while its hash set fits in
+ * SAMPLE_SET_HOT bytes of cache, SAMPLE_FLOYD_COLD once it doesn't
+ * (measured on x86-64 for n = 1e3 .. 1e8). Floyd's set never grows
+ * beyond SAMPLE_SET_MAX bytes; larger samples always scan.
+ */
+#define SAMPLE_SCAN         36
+#define SAMPLE_FLOYD_HOT    55
+#define SAMPLE_FLOYD_COLD   165
+#define SAMPLE_SET_HOT      (1024 * 1024)
+#define SAMPLE_SET_MAX      (64 * 1024 * 1024)
+
+/*
+ * Token alphabets. Every character is encoded from 'bits' bits of a
+ * 64-bit keystream word; 'perword' characters are taken from each
+ * word before moving to the next.
+ */
+struct token_enc
+{
+    const char*     alpha;
+    unsigned int    bits;
+    unsigned int    perword;
+};
+
+static const struct token_enc Token_enc[] = {
+    [ARC4RANDOM_HEX]       = { "0123456789abcdef", 4, 16 },
+    [ARC4RANDOM_BASE32]    = { "ABCDEFGHIJKLMNOPQRSTUVWXYZ234567", 5, 12 },
+    [ARC4RANDOM_BASE64URL] = { "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_", 6, 10 },
+};
+
 
 static inline void
 _rs_init(rand_state* st, u8 *buf, size_t n)
@@ -85,8 +144,13 @@ _rs_init(rand_state* st, u8 *buf, size_t n)
 static inline void
 _rs_rekey(rand_state* st, u8 *dat, size_t datlen)
 {
+#ifdef ARC4RANDOM_STATS
+    if (!dat)
+        st->rs_nrefill++;
+#endif
+
     /* fill rs_buf with the keystream */
-    chacha_encrypt_bytes(&st->rs_chacha, st->rs_buf, st->rs_buf, sizeof st->rs_buf);
+    chacha_keystream(&st->rs_chacha, st->rs_buf, st->rs_buf, sizeof st->rs_buf);
 
     /* mix in optional user provided data */
     if (dat) {
@@ -115,11 +179,17 @@ _rs_stir(rand_state* st)
     int r = getentropy(rnd, sizeof rnd);
     assert(r == 0);
 
+#ifdef ARC4RANDOM_STATS
+    st->rs_nstir++;
+#endif
+
     _rs_rekey(st, rnd, sizeof(rnd));
 
-    /* invalidate rs_buf */
+    /* invalidate rs_buf and the bit reservoir */
     st->rs_have = 0;
     memset(st->rs_buf, 0, sizeof st->rs_buf);
+    st->rs_bits  = 0;
+    st->rs_nbits = 0;
 
     st->rs_count = 1600000;
 }
@@ -174,6 +244,264 @@ _rs_random_u32(rand_state* rs)
     return val;
 }
 
+static inline uint64_t
+_rs_random_u64(rand_state* rs)
+{
+    u8 *keystream;
+    uint64_t val;
+
+    _rs_stir_if_needed(rs, sizeof(val));
+    if (rs->rs_have < sizeof(val))
+        _rs_rekey(rs, NULL, 0);
+    keystream = rs->rs_buf + sizeof(rs->rs_buf) - rs->rs_have;
+    memcpy(&val, keystream, sizeof(val));
+    memset(keystream, 0, sizeof(val));
+    rs->rs_have -= sizeof(val);
+
+    return val;
+}
+
+
+/*
+ * Return 'k' random bits (1 <= k <= 32) from the bit reservoir.
+ *
+ * The reservoir is refilled 64 bits at a time from the keystream;
+ * bits left over from the previous word are used before the
+ * refill, so no keystream is discarded.
+ */
+static inline uint32_t
+_rs_random_bits(rand_state* rs, size_t k)
+{
+    uint64_t v;
+
+    if (rs->rs_nbits >= k) {
+        v = rs->rs_bits;
+        rs->rs_bits  >>= k;
+        rs->rs_nbits  -= k;
+    } else {
+        size_t have = rs->rs_nbits;
+        size_t need = k - have;
+
+        v = rs->rs_bits;
+        rs->rs_bits   = _rs_random_u64(rs);
+        v            |= rs->rs_bits << have;
+        rs->rs_bits >>= need;
+        rs->rs_nbits  = 64 - need;
+    }
+
+    return (uint32_t)(v & ((((uint64_t)1) << k) - 1));
+}
+
+
+
+/*
+ * Uniform random number in [0, bound) using Lemire's nearly
+ * divisionless multiply-and-shift method. The 32-bit draws come
+ * from the bit reservoir, so every 64-bit keystream word yields two
+ * bounded draws. 'bound' must be non-zero.
+ */
+static inline uint32_t
+_rs_bounded32(rand_state* rs, uint32_t bound)
+{
+    uint64_t m = (uint64_t)_rs_random_bits(rs, 32) * bound;
+    uint32_t l = (uint32_t)m;
+
+    if (l < bound) {
+        /* 2**32 % bound */
+        uint32_t t = -bound % bound;
+
+        while (l < t) {
+            m = (uint64_t)_rs_random_bits(rs, 32) * bound;
+            l = (uint32_t)m;
+        }
+    }
+
+    return (uint32_t)(m >> 32);
+}
+
+
+static inline size_t
+_rs_bounded(rand_state* rs, size_t bound)
+{
+#if SIZE_MAX > UINT32_MAX
+    if (bound > UINT32_MAX) {
+        uint64_t mask = bound - 1;
+        uint64_t r;
+
+        mask |= mask >> 1;
+        mask |= mask >> 2;
+        mask |= mask >> 4;
+        mask |= mask >> 8;
+        mask |= mask >> 16;
+        mask |= mask >> 32;
+
+        do {
+            r = _rs_random_u64(rs) & mask;
+        } while (r >= bound);
+
+        return (size_t)r;
+    }
+#endif
+
+    return _rs_bounded32(rs, (uint32_t)bound);
+}
+
+
+static inline void
+_swap(u8* a, u8* b, size_t sz)
+{
+    u8 tmp[64];
+
+    switch (sz) {
+    case 4: {
+        uint32_t t;
+        memcpy(&t, a, 4); memcpy(a, b, 4); memcpy(b, &t, 4);
+        break;
+    }
+    case 8: {
+        uint64_t t;
+        memcpy(&t, a, 8); memcpy(a, b, 8); memcpy(b, &t, 8);
+        break;
+    }
+    default:
+        while (sz > 0) {
+            size_t m = minimum(sz, sizeof tmp);
+
+            memcpy(tmp, a, m);
+            memcpy(a, b, m);
+            memcpy(b, tmp, m);
+            a  += m;
+            b  += m;
+            sz -= m;
+        }
+        break;
+    }
+}
+
+
+/*
+ * Selection sampling (Knuth Algorithm S): one pass over [0, n);
+ * picks index i with probability (k - selected)/(n - i). Output is
+ * in increasing order.
+ */
+static void
+_rs_sample_scan(rand_state* rs, size_t n, size_t k, size_t* out)
+{
+    size_t i, sel = 0;
+
+    for (i = 0; sel < k; i++) {
+        if (_rs_bounded(rs, n - i) < k - sel)
+            out[sel++] = i;
+    }
+}
+
+
+/*
+ * Add 'v' to the open addressed hash set 'set' of 2**(64 - shift)
+ * slots. Return 0 if it was already present.
+ */
+static inline int
+_set_add(size_t* set, unsigned int shift, size_t v)
+{
+    size_t mask = (((size_t)1) << (64 - shift)) - 1;
+    size_t h    = (size_t)(((uint64_t)v * 0x9e3779b97f4a7c15ULL) >> shift);
+
+    while (set[h] != SIZE_MAX) {
+        if (set[h] == v)
+            return 0;
+        h = (h + 1) & mask;
+    }
+
+    set[h] = v;
+    return 1;
+}
+
+
+/*
+ * Slots in Floyd's hash set for 'k' samples: a power of two, at
+ * least 2k. 0 if that is more than SAMPLE_SET_MAX bytes.
+ */
+static size_t
+_floyd_slots(size_t k)
+{
+    size_t sz = 16;
+
+    if (k > SAMPLE_SET_MAX / (2 * sizeof(size_t)))
+        return 0;
+
+    while (sz < 2 * k)
+        sz <<= 1;
+
+    return sz * sizeof(size_t) > SAMPLE_SET_MAX ? 0 : sz;
+}
+
+
+/*
+ * Floyd's algorithm: k bounded draws and a hash set of 'sz' slots
+ * holding the chosen indices. Output is unordered. Returns -1 if
+ * the set can't be allocated; nothing is drawn in that case.
+ */
+static int
+_rs_sample_floyd(rand_state* rs, size_t n, size_t k, size_t sz, size_t* out)
+{
+    unsigned int shift = 64;
+    size_t *set;
+    size_t j, m = 0;
+
+    for (j = sz; j > 1; j >>= 1)
+        shift--;
+
+    if (!(set = (size_t*)malloc(sz * sizeof *set)))
+        return -1;
+    memset(set, 0xff, sz * sizeof *set);
+
+    for (j = n - k; j < n; j++) {
+        size_t t = _rs_bounded(rs, j + 1);
+
+        /* if t was chosen before, choose j - which can't have been */
+        if (!_set_add(set, shift, t)) {
+            t = j;
+            _set_add(set, shift, t);
+        }
+        out[m++] = t;
+    }
+
+    free(set);
+    return 0;
+}
+
+
+/*
+ * Encode 'n' characters of random token into 'out' straight from
+ * the keystream. Whole words are consumed while they last; the
+ * tail comes from the bit reservoir. Base32 and base64url use only
+ * 60 bits of each whole word and drop the top 4.
+ */
+static void
+_rs_token(rand_state* rs, char* out, size_t n, const struct token_enc* e)
+{
+    const char*    alpha = e->alpha;
+    const unsigned bits  = e->bits;
+    const uint64_t mask  = (((uint64_t)1) << bits) - 1;
+    size_t i;
+
+    while (n >= e->perword) {
+        uint64_t w = _rs_random_u64(rs);
+
+        for (i = 0; i < e->perword; i++) {
+            out[i] = alpha[w & mask];
+            w    >>= bits;
+        }
+        out += e->perword;
+        n   -= e->perword;
+    }
+
+    for (i = 0; i < n; i++)
+        out[i] = alpha[_rs_random_bits(rs, bits)];
+
+    out[n] = 0;
+}
+
 
 #if defined(__Darwin__) || defined(__APPLE__)
 
@@ -334,4 +662,169 @@ arc4random_uniform(uint32_t upper_bound)
     return r % upper_bound;
 }
 
+
+uint32_t
+arc4random_bit()
+{
+    rand_state* z = sget();
+
+    return _rs_random_bits(z, 1);
+}
+
+
+uint32_t
+arc4random_bits(unsigned int k)
+{
+    rand_state* z = sget();
+
+    if (k == 0)
+        return 0;
+    if (k > 32)
+        k = 32;
+
+    return _rs_random_bits(z, k);
+}
+
+
+/*
+ * Fisher-Yates shuffle. Swap targets are drawn and prefetched
+ * SHUFFLE_BATCH at a time; on arrays larger than the cache each
+ * swap is otherwise a dependent cache miss.
+ */
+void
+arc4random_shuffle(void* base, size_t n, size_t elem_size)
+{
+    rand_state* z;
+    u8* b = (u8 *)base;
+    size_t j[SHUFFLE_BATCH];
+    size_t i, k, m;
+
+    if (n < 2 || elem_size == 0)
+        return;
+
+    z = sget();
+    for (i = n - 1; i > 0; ) {
+        m = minimum(i, SHUFFLE_BATCH);
+        for (k = 0; k < m; k++) {
+            j[k] = _rs_bounded(z, i - k + 1);
+            prefetchw(b + j[k] * elem_size);
+        }
+
+        for (k = 0; k < m; k++, i--)
+            _swap(b + i * elem_size, b + j[k] * elem_size, elem_size);
+    }
+}
+
+
+/*
+ * Choose 'k' distinct indices uniformly from [0, n). Floyd's
+ * algorithm is used when the cost model says it beats a scan of the
+ * whole range and its hash set can be had; otherwise scan.
+ */
+int
+arc4random_sample_indices(size_t n, size_t k, size_t* out)
+{
+    rand_state* z;
+    size_t sz;
+
+    if (k > n) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (k == 0)
+        return 0;
+
+    z  = sget();
+    sz = _floyd_slots(k);
+    if (sz > 0) {
+        double floyd = sz * sizeof(size_t) <= SAMPLE_SET_HOT ? SAMPLE_FLOYD_HOT : SAMPLE_FLOYD_COLD;
+
+        if ((double)k * floyd < (double)n * SAMPLE_SCAN &&
+            _rs_sample_floyd(z, n, k, sz, out) == 0)
+            return 0;
+    }
+
+    _rs_sample_scan(z, n, k, out);
+    return 0;
+}
+
+
+int
+arc4random_token(char* out, size_t nchars, enum arc4random_encoding enc)
+{
+    return arc4random_tokens(out, 1, nchars, enc);
+}
+
+
+int
+arc4random_tokens(char* out, size_t ntokens, size_t nchars, enum arc4random_encoding enc)
+{
+    rand_state* z;
+    size_t i;
+
+    if ((unsigned)enc >= sizeof Token_enc / sizeof Token_enc[0]) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    z = sget();
+    for (i = 0; i < ntokens; i++, out += nchars + 1)
+        _rs_token(z, out, nchars, &Token_enc[enc]);
+
+    return 0;
+}
+
+
+#ifdef ARC4RANDOM_STATS
+
+void
+arc4random_stats(struct arc4random_stats* s)
+{
+    rand_state* z = sget();
+
+    s->refills = z->rs_nrefill;
+    s->stirs   = z->rs_nstir;
+}
+
+#endif /* ARC4RANDOM_STATS */
+
+
+/*
+ * Return 1 with probability p_num/p_den and 0 otherwise.
+ *
+ * We lazily compare a random binary fraction U against the binary
+ * expansion of p = p_num/p_den one bit at a time and stop at the
+ * first bit where they differ. The expected number of random bits
+ * consumed is 2 - regardless of p.
+ */
+int
+arc4random_bool(uint32_t p_num, uint32_t p_den)
+{
+    rand_state* z = sget();
+    uint64_t r = p_num;
+
+    if (p_num == 0 || p_den == 0)
+        return 0;
+    if (p_num >= p_den)
+        return 1;
+
+    for (;;) {
+        uint32_t pb, ub;
+
+        /* next bit of the binary expansion of p */
+        r <<= 1;
+        pb  = r >= p_den;
+        if (pb)
+            r -= p_den;
+
+        ub = _rs_random_bits(z, 1);
+        if (ub != pb)
+            return ub < pb;
+
+        /* p has a finite expansion; U >= p from here on */
+        if (r == 0)
+            return 0;
+    }
+}
+
 /* EOF */
@@ -63,6 +63,135 @@ extern uint32_t arc4random_uniform(uint32_t upper_bound);
  */
 extern void arc4random_buf(void* buf, size_t n);
 
+
+/*
+ * Sub-word draws from a per-thread 64-bit bit reservoir. These
+ * consume only as many keystream bits as they return.
+ */
+
+/*
+ * Generate and return a single random bit (0 or 1).
+ */
+extern uint32_t arc4random_bit(void);
+
+
+/*
+ * Generate and return 'k' random bits in the low bits of the
+ * result; 'k' is clamped to 32. Returns 0 when 'k' is 0.
+ */
+extern uint32_t arc4random_bits(unsigned int k);
+
+
+/*
+ * Return 1 with probability 'p_num/p_den' and 0 otherwise. Uses 2
+ * random bits on average. Returns 0 if 'p_den' is 0.
+ */
+extern int arc4random_bool(uint32_t p_num, uint32_t p_den);
+
+
+/*
+ * Shuffle the 'n' elements of 'elem_size' bytes each at 'base'
+ * into a uniformly random order (Fisher-Yates).
+ */
+extern void arc4random_shuffle(void* base, size_t n, size_t elem_size);
+
+
+/*
+ * Choose 'k' distinct indices uniformly at random from [0, n) and
+ * write them to 'out'. The order of the indices in 'out' is
+ * unspecified. Returns 0 on success and -1 (with errno set to
+ * EINVAL) if 'k' is larger than 'n'.
+ */
+extern int arc4random_sample_indices(size_t n, size_t k, size_t* out);
+
+
+/*
+ * Random token encodings:
+ *
+ *  ARC4RANDOM_HEX:         lower case hex;         4 bits/char
+ *  ARC4RANDOM_BASE32:      RFC 4648 base32;        5 bits/char
+ *  ARC4RANDOM_BASE64URL:   RFC 4648 base64url;     6 bits/char
+ *
+ * Tokens are unpadded.
+ */
+enum arc4random_encoding
+{
+    ARC4RANDOM_HEX = 0,
+    ARC4RANDOM_BASE32,
+    ARC4RANDOM_BASE64URL,
+};
+
+
+/*
+ * Generate a random token of 'nchars' characters in encoding 'enc'
+ * and put it in 'out' followed by a NUL; 'out' must have room for
+ * 'nchars + 1' bytes. Characters are encoded directly from the
+ * keystream. Returns 0 on success and -1 (errno = EINVAL) for an
+ * unknown encoding.
+ */
+extern int arc4random_token(char* out, size_t nchars, enum arc4random_encoding enc);
+
+
+/*
+ * Generate 'ntokens' tokens as above; token 'i' is written at
+ * 'out + i * (nchars + 1)'.
+ */
+extern int arc4random_tokens(char* out, size_t ntokens, size_t nchars, enum arc4random_encoding enc);
+
+
+/*
+ * Non-uniform distributions (randdist.c). Gaussian and exponential
+ * variates use the ziggurat method and need one 64-bit keystream
+ * word in the common case. Link with -lm.
+ */
+
+/*
+ * Generate and return a standard normal (mean 0, variance 1)
+ * variate.
+ */
+extern double arc4random_normal(void);
+
+
+/*
+ * Generate and return an exponential variate with mean 1.
+ */
+extern double arc4random_exponential(void);
+
+
+/*
+ * Generate and return a Poisson variate with mean 'lambda'.
+ * Returns 0 if 'lambda' is not positive, not finite or larger
+ * than 1e18.
+ */
+extern uint64_t arc4random_poisson(double lambda);
+
+
+/*
+ * Fill 'out' with 'n' variates of the corresponding distribution.
+ * Keystream is fetched in large batches - these are much faster
+ * than calling the single variate functions in a loop.
+ */
+extern void arc4random_normal_fill(double* out, size_t n);
+extern void arc4random_exponential_fill(double* out, size_t n);
+extern void arc4random_poisson_fill(uint64_t* out, size_t n, double lambda);
+
+
+#ifdef ARC4RANDOM_STATS
+
+/*
+ * Instrumented builds only (-DARC4RANDOM_STATS): per-thread counts
+ * of keystream buffer refills and reseeds from getentropy().
+ */
+struct arc4random_stats
+{
+    uint64_t    refills;
+    uint64_t    stirs;
+};
+
+extern void arc4random_stats(struct arc4random_stats* s);
+
+#endif /* ARC4RANDOM_STATS */
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
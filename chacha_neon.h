@@ -0,0 +1,147 @@
+/* vim: expandtab:tw=68:ts=4:sw=4:
+ *
+ * chacha_neon.h - 4-way NEON ChaCha20 keystream for AArch64
+ *
+ * Copyright (c) 2015 Sudhi Herle <sw at herle.net>
+ *
+ * Licensing Terms: GPLv2
+ *
+ * If you need a commercial license for this work, please contact
+ * the author.
+ *
+ * This software does not come with any express or implied
+ * warranty; it is provided "as is". No claim  is made to its
+ * suitability for any purpose.
+ */
+
+/*
+ * Generates four consecutive 64 byte blocks at a time. Each of the
+ * 16 state words lives in its own vector whose four lanes belong
+ * to the four blocks; the quarter rounds are then plain lane-wise
+ * ops and the blocks are transposed back into byte order on store.
+ *
+ * The output is byte-for-byte identical to chacha_encrypt_bytes()
+ * in chacha_private.h - including the 64-bit block counter in
+ * input[12..13]. Like arc4random.c, this is keystream only; 'm' is
+ * passed to the scalar code for the final partial chunk and is
+ * otherwise ignored.
+ *
+ * Must be included after chacha_private.h. On hosts without NEON
+ * (t_kat only) the intrinsics come from neon_emu.h.
+ */
+
+#ifndef __CHACHA_NEON_H__
+#define __CHACHA_NEON_H__ 1
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#else
+#include "neon_emu.h"
+#endif
+
+#define CHACHA_NEON_BLOCKS  4
+#define CHACHA_NEON_BYTES   (CHACHA_NEON_BLOCKS * 64)
+
+#define ROTV(v, n)  vsriq_n_u32(vshlq_n_u32((v), (n)), (v), 32 - (n))
+#define ROTV16(v)   vreinterpretq_u32_u16(vrev32q_u16(vreinterpretq_u16_u32(v)))
+
+#define QUARTERROUNDV(a, b, c, d) \
+    a = vaddq_u32(a, b); d = ROTV16(veorq_u32(d, a)); \
+    c = vaddq_u32(c, d); b = ROTV(veorq_u32(b, c), 12); \
+    a = vaddq_u32(a, b); d = ROTV(veorq_u32(d, a), 8); \
+    c = vaddq_u32(c, d); b = ROTV(veorq_u32(b, c), 7);
+
+
+/*
+ * Transpose words a..d of the four blocks and store them at word
+ * offset 'w' of each block.
+ */
+static inline void
+chacha_neon_store4(u8* c, unsigned w, uint32x4_t a, uint32x4_t b, uint32x4_t cc, uint32x4_t d)
+{
+    uint32x4_t t0 = vtrn1q_u32(a, b);
+    uint32x4_t t1 = vtrn2q_u32(a, b);
+    uint32x4_t t2 = vtrn1q_u32(cc, d);
+    uint32x4_t t3 = vtrn2q_u32(cc, d);
+
+#define _u64(x)     vreinterpretq_u64_u32(x)
+#define _u32(x)     vreinterpretq_u32_u64(x)
+    vst1q_u8(c + 0*64 + 4*w, vreinterpretq_u8_u32(_u32(vtrn1q_u64(_u64(t0), _u64(t2)))));
+    vst1q_u8(c + 1*64 + 4*w, vreinterpretq_u8_u32(_u32(vtrn1q_u64(_u64(t1), _u64(t3)))));
+    vst1q_u8(c + 2*64 + 4*w, vreinterpretq_u8_u32(_u32(vtrn2q_u64(_u64(t0), _u64(t2)))));
+    vst1q_u8(c + 3*64 + 4*w, vreinterpretq_u8_u32(_u32(vtrn2q_u64(_u64(t1), _u64(t3)))));
+#undef _u64
+#undef _u32
+}
+
+
+static void
+chacha_encrypt_bytes_neon(chacha_ctx *x, const u8 *m, u8 *c, u32 bytes)
+{
+    static const uint32_t lane[4] = { 0, 1, 2, 3 };
+    const uint32x4_t vlane = vld1q_u32(lane);
+    uint64_t ctr = ((uint64_t)x->input[13] << 32) | x->input[12];
+    int i;
+
+    while (bytes >= CHACHA_NEON_BYTES) {
+        uint32x4_t j[16];
+        uint32x4_t x0, x1, x2, x3, x4, x5, x6, x7, x8, x9, x10, x11, x12, x13, x14, x15;
+        uint32x4_t lo, carry;
+
+        for (i = 0; i < 16; i++)
+            j[i] = vdupq_n_u32(x->input[i]);
+
+        /* per-block counters; carry into the high word on wrap */
+        lo    = vaddq_u32(vdupq_n_u32((uint32_t)ctr), vlane);
+        carry = vcltq_u32(lo, vdupq_n_u32((uint32_t)ctr));
+        j[12] = lo;
+        j[13] = vsubq_u32(vdupq_n_u32((uint32_t)(ctr >> 32)), carry);
+
+        x0  = j[0];  x1  = j[1];  x2  = j[2];  x3  = j[3];
+        x4  = j[4];  x5  = j[5];  x6  = j[6];  x7  = j[7];
+        x8  = j[8];  x9  = j[9];  x10 = j[10]; x11 = j[11];
+        x12 = j[12]; x13 = j[13]; x14 = j[14]; x15 = j[15];
+
+        for (i = 20; i > 0; i -= 2) {
+            QUARTERROUNDV( x0, x4, x8,x12)
+            QUARTERROUNDV( x1, x5, x9,x13)
+            QUARTERROUNDV( x2, x6,x10,x14)
+            QUARTERROUNDV( x3, x7,x11,x15)
+            QUARTERROUNDV( x0, x5,x10,x15)
+            QUARTERROUNDV( x1, x6,x11,x12)
+            QUARTERROUNDV( x2, x7, x8,x13)
+            QUARTERROUNDV( x3, x4, x9,x14)
+        }
+
+        x0  = vaddq_u32(x0,  j[0]);  x1  = vaddq_u32(x1,  j[1]);
+        x2  = vaddq_u32(x2,  j[2]);  x3  = vaddq_u32(x3,  j[3]);
+        x4  = vaddq_u32(x4,  j[4]);  x5  = vaddq_u32(x5,  j[5]);
+        x6  = vaddq_u32(x6,  j[6]);  x7  = vaddq_u32(x7,  j[7]);
+        x8  = vaddq_u32(x8,  j[8]);  x9  = vaddq_u32(x9,  j[9]);
+        x10 = vaddq_u32(x10, j[10]); x11 = vaddq_u32(x11, j[11]);
+        x12 = vaddq_u32(x12, j[12]); x13 = vaddq_u32(x13, j[13]);
+        x14 = vaddq_u32(x14, j[14]); x15 = vaddq_u32(x15, j[15]);
+
+        chacha_neon_store4(c,  0, x0,  x1,  x2,  x3);
+        chacha_neon_store4(c,  4, x4,  x5,  x6,  x7);
+        chacha_neon_store4(c,  8, x8,  x9,  x10, x11);
+        chacha_neon_store4(c, 12, x12, x13, x14, x15);
+
+        ctr += CHACHA_NEON_BLOCKS;
+        x->input[12] = (uint32_t)ctr;
+        x->input[13] = (uint32_t)(ctr >> 32);
+
+        c     += CHACHA_NEON_BYTES;
+        m     += CHACHA_NEON_BYTES;
+        bytes -= CHACHA_NEON_BYTES;
+    }
+
+    if (bytes > 0)
+        chacha_encrypt_bytes(x, m, c, bytes);
+}
+
+#undef QUARTERROUNDV
+#undef ROTV16
+#undef ROTV
+
+#endif /* __CHACHA_NEON_H__ */
@@ -8,6 +8,11 @@
  *
  * NB: Relative cycle counts and difference between two
  *     cpu-timestamps are meaningful ONLY when run on the _same_ CPU.
+ *
+ * NB: On AArch64 the virtual counter ticks at the generic timer
+ *     frequency (CNTFRQ_EL0) - not the CPU clock. Elsewhere we
+ *     fall back to nanoseconds from the monotonic clock. Compare
+ *     numbers only between runs on the same kind of machine.
  */
 #if defined(__i386__)
 
@@ -31,10 +36,29 @@ static inline uint64_t sys_cpu_timestamp(void)
     return (res << 32) | lo;
 }
 
+#elif defined(__aarch64__)
+
+
+static inline uint64_t sys_cpu_timestamp(void)
+{
+    uint64_t res;
+    __asm__ __volatile__ ("isb; mrs %0, cntvct_el0" : "=r"(res) :: "memory");
+
+    return res;
+}
+
 #else
 
-#error "I don't know how to get CPU cycle counter for this machine!"
+#include <time.h>
+
+static inline uint64_t sys_cpu_timestamp(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ((uint64_t)ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
 
-#endif /* x86, x86_64 */
+#endif /* x86, x86_64, aarch64 */
 
 #endif /* __CPUTIME_H__ */
@@ -0,0 +1,38 @@
+#include <jni.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "arc4random.h"
+#include "wipe.h"
+
+/* Bytes generated per slice of fill() */
+#define FILL_SLICE      4096
+
+/*
+ * Class:     net_herle_random_Arc4RandomSpi
+ * Method:    fill
+ * Signature: ([BII)V
+ *
+ * Generates FILL_SLICE bytes at a time into a native buffer and
+ * copies them out; no JNI critical region is held while generating
+ * (a reseed reads from the kernel). The Java side bounds 'off' and
+ * 'len'.
+ */
+JNIEXPORT void JNICALL Java_net_herle_random_Arc4RandomSpi_fill
+  (JNIEnv *env, jclass cls, jbyteArray arr, jint off, jint len)
+{
+    uint8_t buf[FILL_SLICE];
+
+    while (len > 0) {
+        jint m = len < FILL_SLICE ? len : FILL_SLICE;
+
+        arc4random_buf(buf, m);
+        (*env)->SetByteArrayRegion(env, arr, off, m, (const jbyte*) &buf[0]);
+
+        off += m;
+        len -= m;
+    }
+
+    /* don't leave keystream on the stack */
+    wipe(buf, sizeof buf);
+}
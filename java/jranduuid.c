@@ -2,7 +2,7 @@
 #include <stdint.h>
 #include <stdlib.h>
 
-extern void randuuid(uint8_t*, size_t);
+#include "randuuid.h"
 
 /*
  * Class:     net_herle_random_mtarc4random
@@ -19,3 +19,53 @@ JNIEXPORT void JNICALL Java_net_herle_random_mtarc4random_randuuid
     (*env)->SetByteArrayRegion(env, arr, 0, 16, (const jbyte*) &buf[0]);
 }
 
+
+/*
+ * Class:     net_herle_random_mtarc4random
+ * Method:    randuuid7
+ * Signature: ([B)V
+ */
+JNIEXPORT void JNICALL Java_net_herle_random_mtarc4random_randuuid7
+  (JNIEnv *env, jobject obj, jbyteArray arr)
+{
+    uint8_t buf[16];
+
+    randuuid7(buf, sizeof buf);
+
+    (*env)->SetByteArrayRegion(env, arr, 0, 16, (const jbyte*) &buf[0]);
+}
+
+
+/* UUIDs generated per slice of randuuid7Batch() */
+#define UUID7_SLICE     256
+
+/*
+ * Class:     net_herle_random_mtarc4random
+ * Method:    randuuid7Batch
+ * Signature: ([BI)V
+ *
+ * Generates UUID7_SLICE UUIDs at a time into a native buffer and
+ * copies them out; no JNI critical region is held while generating.
+ * 'n' is clamped to the number of UUIDs that fit.
+ */
+JNIEXPORT void JNICALL Java_net_herle_random_mtarc4random_randuuid7Batch
+  (JNIEnv *env, jobject obj, jbyteArray arr, jint n)
+{
+    uint8_t buf[UUID7_SLICE * 16];
+    jsize len = (*env)->GetArrayLength(env, arr);
+    jsize off = 0;
+
+    if (n <= 0) return;
+    if (n > len / 16) n = len / 16;
+
+    while (n > 0) {
+        jint m = n < UUID7_SLICE ? n : UUID7_SLICE;
+
+        randuuid7_batch(buf, m);
+        (*env)->SetByteArrayRegion(env, arr, off, m * 16, (const jbyte*) &buf[0]);
+
+        off += m * 16;
+        n   -= m;
+    }
+}
+
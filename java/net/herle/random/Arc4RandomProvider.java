@@ -0,0 +1,29 @@
+package net.herle.random;
+
+import java.security.Provider;
+
+/*
+ * JCA provider for the "ARC4RANDOM" SecureRandom algorithm.
+ *
+ * The engine is thread safe without locking, so SecureRandom does
+ * not synchronize calls into it.
+ *
+ *   Security.insertProviderAt(new Arc4RandomProvider(), 1);
+ *   SecureRandom r = SecureRandom.getInstance("ARC4RANDOM");
+ *
+ * The native library must be loaded before use.
+ */
+public final class Arc4RandomProvider extends Provider {
+
+    private static final long serialVersionUID = 1L;
+
+    public static final String NAME      = "MTArc4Random";
+    public static final String ALGORITHM = "ARC4RANDOM";
+
+    public Arc4RandomProvider() {
+        super(NAME, 1.0, "SecureRandom backed by mt-arc4random (ChaCha20)");
+
+        put("SecureRandom." + ALGORITHM, Arc4RandomSpi.class.getName());
+        put("SecureRandom." + ALGORITHM + " ThreadSafe", "true");
+    }
+}
@@ -0,0 +1,90 @@
+package net.herle.random;
+
+import java.security.SecureRandomSpi;
+import java.util.Arrays;
+
+/*
+ * SecureRandom engine backed by mt-arc4random.
+ *
+ * Every Java thread draws from its own buffer which is refilled
+ * BUFSZ bytes at a time with a single JNI call; nextInt(),
+ * nextLong() and small nextBytes() calls stay in Java. The native
+ * generator is per-thread as well, so there is no lock anywhere on
+ * the path. Consumed bytes are zeroed in the buffer.
+ */
+public final class Arc4RandomSpi extends SecureRandomSpi {
+
+    private static final long serialVersionUID = 1L;
+
+    // Bytes fetched per refill of a thread's buffer.
+    static final int BUFSZ = 4096;
+
+    // Requests at least this large bypass the buffer.
+    static final int DIRECT = BUFSZ / 2;
+
+    // A provider installed via java.security or insertProviderAt()
+    // has nobody else to load the native code for it.
+    static {
+        System.loadLibrary("randuuid");
+    }
+
+    private static final class Pool {
+        final byte[] buf = new byte[BUFSZ];
+        int pos = BUFSZ;    // first unused byte
+    }
+
+    private static final ThreadLocal<Pool> POOL = new ThreadLocal<Pool>() {
+        @Override
+        protected Pool initialValue() {
+            return new Pool();
+        }
+    };
+
+    public Arc4RandomSpi() {
+        super();
+    }
+
+    // arc4random seeds (and reseeds) itself from the kernel; caller
+    // supplied seed material is not needed and is ignored.
+    @Override
+    protected void engineSetSeed(byte[] seed) {
+    }
+
+    @Override
+    protected void engineNextBytes(byte[] bytes) {
+        int n = bytes.length;
+
+        if (n >= DIRECT) {
+            fill(bytes, 0, n);
+            return;
+        }
+
+        Pool p = POOL.get();
+        int off = 0;
+        while (off < n) {
+            if (p.pos == BUFSZ) {
+                fill(p.buf, 0, BUFSZ);
+                p.pos = 0;
+            }
+
+            int m = Math.min(n - off, BUFSZ - p.pos);
+            System.arraycopy(p.buf, p.pos, bytes, off, m);
+            Arrays.fill(p.buf, p.pos, p.pos + m, (byte) 0);
+            p.pos += m;
+            off += m;
+        }
+    }
+
+    @Override
+    protected byte[] engineGenerateSeed(int numBytes) {
+        byte[] b = new byte[numBytes];
+
+        fill(b, 0, numBytes);
+        return b;
+    }
+
+    // Fill b[off, off+len) from arc4random_buf(). The native side
+    // generates in small slices and copies them in, so any length is
+    // fine.
+    static native void fill(byte[] b, int off, int len);
+}
@@ -3,4 +3,10 @@ package net.herle.random;
 public class mtarc4random {
 
     public native void randuuid(byte[] uuid);
+
+    // Time ordered (version 7) UUID; 'uuid' must hold 16 bytes.
+    public native void randuuid7(byte[] uuid);
+
+    // 'n' consecutive version 7 UUIDs into 'uuids' (16 * n bytes).
+    public native void randuuid7Batch(byte[] uuids, int n);
 }
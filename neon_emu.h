@@ -0,0 +1,141 @@
+/* vim: expandtab:tw=68:ts=4:sw=4:
+ *
+ * neon_emu.h - Portable stand-ins for the NEON intrinsics used by
+ *              chacha_neon.h
+ *
+ * Copyright (c) 2015 Sudhi Herle <sw at herle.net>
+ *
+ * Licensing Terms: GPLv2
+ *
+ * If you need a commercial license for this work, please contact
+ * the author.
+ *
+ * This software does not come with any express or implied
+ * warranty; it is provided "as is". No claim  is made to its
+ * suitability for any purpose.
+ */
+
+/*
+ * Lets t_kat run the NEON ChaCha kernel through its known answer
+ * and differential tests on hosts without NEON. Each intrinsic is
+ * written lane by lane from its definition in the Arm ARM using
+ * GCC/clang vector types; speed is not a goal. Little-endian hosts
+ * only - like AArch64 in the configuration chacha_neon.h supports.
+ *
+ * Not used by the library itself.
+ */
+
+#ifndef __NEON_EMU_H__
+#define __NEON_EMU_H__ 1
+
+#include <stdint.h>
+#include <string.h>
+
+#if !defined(__BYTE_ORDER__) || __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "neon_emu.h needs a little-endian host"
+#endif
+
+typedef uint8_t  uint8x16_t __attribute__((vector_size(16)));
+typedef uint16_t uint16x8_t __attribute__((vector_size(16)));
+typedef uint32_t uint32x4_t __attribute__((vector_size(16)));
+typedef uint64_t uint64x2_t __attribute__((vector_size(16)));
+
+
+static inline uint32x4_t
+vdupq_n_u32(uint32_t v)
+{
+    uint32x4_t r = { v, v, v, v };
+    return r;
+}
+
+
+static inline uint32x4_t
+vld1q_u32(const uint32_t* p)
+{
+    uint32x4_t r;
+
+    memcpy(&r, p, sizeof r);
+    return r;
+}
+
+
+static inline void
+vst1q_u8(uint8_t* p, uint8x16_t v)
+{
+    memcpy(p, &v, sizeof v);
+}
+
+
+static inline uint32x4_t vaddq_u32(uint32x4_t a, uint32x4_t b) { return a + b; }
+static inline uint32x4_t vsubq_u32(uint32x4_t a, uint32x4_t b) { return a - b; }
+static inline uint32x4_t veorq_u32(uint32x4_t a, uint32x4_t b) { return a ^ b; }
+
+/* all ones in each lane where a < b */
+static inline uint32x4_t
+vcltq_u32(uint32x4_t a, uint32x4_t b)
+{
+    uint32x4_t r;
+    int i;
+
+    for (i = 0; i < 4; i++)
+        r[i] = a[i] < b[i] ? 0xffffffff : 0;
+    return r;
+}
+
+
+#define vshlq_n_u32(a, n)   ((uint32x4_t)(a) << (n))
+
+/* shift b right by n and insert, keeping the top n bits of a */
+#define vsriq_n_u32(a, b, n) \
+    (((uint32x4_t)(a) & vdupq_n_u32(~(0xffffffffu >> (n)))) | ((uint32x4_t)(b) >> (n)))
+
+
+#define vreinterpretq_u16_u32(x)    ((uint16x8_t)(x))
+#define vreinterpretq_u32_u16(x)    ((uint32x4_t)(x))
+#define vreinterpretq_u64_u32(x)    ((uint64x2_t)(x))
+#define vreinterpretq_u32_u64(x)    ((uint32x4_t)(x))
+#define vreinterpretq_u8_u32(x)     ((uint8x16_t)(x))
+
+
+/* swap the two halfwords of every word */
+static inline uint16x8_t
+vrev32q_u16(uint16x8_t v)
+{
+    uint16x8_t r = { v[1], v[0], v[3], v[2], v[5], v[4], v[7], v[6] };
+    return r;
+}
+
+
+/* even (trn1) or odd (trn2) lanes of a and b, interleaved */
+static inline uint32x4_t
+vtrn1q_u32(uint32x4_t a, uint32x4_t b)
+{
+    uint32x4_t r = { a[0], b[0], a[2], b[2] };
+    return r;
+}
+
+
+static inline uint32x4_t
+vtrn2q_u32(uint32x4_t a, uint32x4_t b)
+{
+    uint32x4_t r = { a[1], b[1], a[3], b[3] };
+    return r;
+}
+
+
+static inline uint64x2_t
+vtrn1q_u64(uint64x2_t a, uint64x2_t b)
+{
+    uint64x2_t r = { a[0], b[0] };
+    return r;
+}
+
+
+static inline uint64x2_t
+vtrn2q_u64(uint64x2_t a, uint64x2_t b)
+{
+    uint64x2_t r = { a[1], b[1] };
+    return r;
+}
+
+#endif /* __NEON_EMU_H__ */
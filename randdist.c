@@ -0,0 +1,409 @@
+/* vim: expandtab:tw=68:ts=4:sw=4:
+ *
+ * randdist.c - Non-uniform distributions based on Arc4Random
+ *
+ * Copyright (c) 2015 Sudhi Herle <sw at herle.net>
+ *
+ * Licensing Terms: GPLv2
+ *
+ * If you need a commercial license for this work, please contact
+ * the author.
+ *
+ * This software does not come with any express or implied
+ * warranty; it is provided "as is". No claim  is made to its
+ * suitability for any purpose.
+ */
+
+/*
+ * Gaussian and exponential variates use the 256 layer ziggurat
+ * method of Marsaglia & Tsang (with Doornik's improvements); each
+ * variate needs one 64-bit keystream word in the common case.
+ * Poisson variates use multiplication of uniforms for small means
+ * and Hoermann's PTRS transformed rejection for large ones.
+ *
+ * The ziggurat tables are computed once per process.
+ */
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+
+#include "arc4random.h"
+#include "wipe.h"
+
+
+#define ZIG_N           256
+
+/* Normal: right-most layer boundary and area of each layer */
+#define ZIG_NOR_R       3.6541528853610088
+#define ZIG_NOR_V       0.00492867323399
+
+/* Exponential: right-most layer boundary and area of each layer */
+#define ZIG_EXP_R       7.69711747013104972
+#define ZIG_EXP_V       0.0039496598225815571993
+
+/* Poisson means below this use multiplication of uniforms */
+#define POISSON_SMALL   10.0
+
+/*
+ * Largest supported Poisson mean; keeps every variate well inside
+ * uint64_t.
+ */
+#define POISSON_MAX     1e18
+
+/* lambda is out of range (or NaN) */
+#define POISSON_BAD(l)  (!((l) > 0.0 && (l) <= POISSON_MAX))
+
+/* Number of 64-bit words fetched at a time by the batch APIs */
+#define WORDS_BATCH     64
+
+/*
+ * Layer boundaries x[i] (decreasing) and the ratios x[i+1]/x[i]
+ * used for the fast-path test, along with f(x[i]).
+ */
+struct zig
+{
+    double x[ZIG_N + 1];
+    double r[ZIG_N];
+    double f[ZIG_N + 1];
+};
+
+static struct zig       Znor;
+static struct zig       Zexp;
+static pthread_once_t   Zonce = PTHREAD_ONCE_INIT;
+
+
+/*
+ * A small cache of keystream words; batch callers fetch many words
+ * per arc4random_buf() call while single variates fetch just one.
+ */
+struct words
+{
+    uint64_t    w[WORDS_BATCH];
+    size_t      i;
+    size_t      n;
+    size_t      max;
+};
+
+
+static inline void
+words_init(struct words* ws, size_t max)
+{
+    ws->i   = 0;
+    ws->n   = 0;
+    ws->max = max > WORDS_BATCH ? WORDS_BATCH : max;
+}
+
+
+static inline void
+words_fini(struct words* ws)
+{
+    /* don't leave unused keystream on the stack */
+    wipe(ws->w, ws->n * sizeof ws->w[0]);
+}
+
+
+static inline uint64_t
+words_next(struct words* ws)
+{
+    if (ws->i == ws->n) {
+        ws->n = ws->max;
+        ws->i = 0;
+        arc4random_buf(ws->w, ws->n * sizeof ws->w[0]);
+    }
+
+    return ws->w[ws->i++];
+}
+
+
+/*
+ * Uniform double in [0, 1) with 53 bits of precision from the top
+ * bits of 'u'.
+ */
+static inline double
+u53(uint64_t u)
+{
+    return (double)(u >> 11) * (1.0 / 9007199254740992.0);
+}
+
+
+/*
+ * Uniform double in (0, 1) - safe to pass to log().
+ */
+static inline double
+u53_open(struct words* ws)
+{
+    return ((double)(words_next(ws) >> 12) + 0.5) * (1.0 / 4503599627370496.0);
+}
+
+
+static double
+nor_f(double x)
+{
+    return exp(-0.5 * x * x);
+}
+
+
+static double
+nor_finv(double y)
+{
+    return sqrt(-2.0 * log(y));
+}
+
+
+static double
+exp_f(double x)
+{
+    return exp(-x);
+}
+
+
+static double
+exp_finv(double y)
+{
+    return -log(y);
+}
+
+
+static void
+zig_setup(struct zig* z, double R, double V, double (*f)(double), double (*finv)(double))
+{
+    int i;
+
+    z->x[0] = V / f(R);
+    z->x[1] = R;
+    for (i = 1; i < ZIG_N - 1; i++) {
+        double y = V / z->x[i] + f(z->x[i]);
+
+        z->x[i+1] = y < 1.0 ? finv(y) : 0.0;
+    }
+    z->x[ZIG_N] = 0.0;
+
+    for (i = 0; i < ZIG_N; i++)
+        z->r[i] = z->x[i+1] / z->x[i];
+
+    for (i = 0; i <= ZIG_N; i++)
+        z->f[i] = f(z->x[i]);
+}
+
+
+static void
+zcreate()
+{
+    zig_setup(&Znor, ZIG_NOR_R, ZIG_NOR_V, nor_f, nor_finv);
+    zig_setup(&Zexp, ZIG_EXP_R, ZIG_EXP_V, exp_f, exp_finv);
+}
+
+
+/*
+ * Standard normal variate. The low 8 bits of each word select the
+ * layer, bit 8 the sign and the top 53 bits the position in the
+ * layer.
+ */
+static double
+normal(struct words* ws)
+{
+    const struct zig* z = &Znor;
+
+    for (;;) {
+        uint64_t u = words_next(ws);
+        unsigned i = u & 0xff;
+        double   s = (u & 0x100) ? -1.0 : 1.0;
+        double   U = u53(u);
+        double   x = U * z->x[i];
+
+        if (U < z->r[i])
+            return s * x;
+
+        if (i == 0) {
+            /* sample from the tail beyond R */
+            double a, b;
+            do {
+                a = -log(u53_open(ws)) / ZIG_NOR_R;
+                b = -log(u53_open(ws));
+            } while (b + b < a * a);
+
+            return s * (ZIG_NOR_R + a);
+        }
+
+        if (z->f[i+1] + u53(words_next(ws)) * (z->f[i] - z->f[i+1]) < nor_f(x))
+            return s * x;
+    }
+}
+
+
+/*
+ * Standard (unit mean) exponential variate.
+ */
+static double
+exponential(struct words* ws)
+{
+    const struct zig* z = &Zexp;
+    double base = 0.0;
+
+    for (;;) {
+        uint64_t u = words_next(ws);
+        unsigned i = u & 0xff;
+        double   U = u53(u);
+        double   x = U * z->x[i];
+
+        if (U < z->r[i])
+            return base + x;
+
+        if (i == 0) {
+            /* the tail beyond R is itself exponential */
+            base += ZIG_EXP_R;
+            continue;
+        }
+
+        if (z->f[i+1] + u53(words_next(ws)) * (z->f[i] - z->f[i+1]) < exp_f(x))
+            return base + x;
+    }
+}
+
+
+static uint64_t
+poisson(struct words* ws, double lambda)
+{
+    if (lambda < POISSON_SMALL) {
+        double   L = exp(-lambda);
+        double   p = u53_open(ws);
+        uint64_t k = 0;
+
+        while (p > L) {
+            p *= u53_open(ws);
+            k++;
+        }
+        return k;
+    }
+
+    /*
+     * PTRS: W. Hoermann, "The transformed rejection method for
+     * generating Poisson random variables", 1993.
+     */
+    double slam   = sqrt(lambda);
+    double loglam = log(lambda);
+    double b      = 0.931 + 2.53 * slam;
+    double a      = -0.059 + 0.02483 * b;
+    double invalp = 1.1239 + 1.1328 / (b - 3.4);
+    double vr     = 0.9277 - 3.6224 / (b - 2.0);
+    int    sign;
+
+    for (;;) {
+        double U  = u53_open(ws) - 0.5;
+        double V  = u53_open(ws);
+        double us = 0.5 - fabs(U);
+        double k  = floor((2.0 * a / us + b) * U + lambda + 0.43);
+
+        if (us >= 0.07 && V <= vr)
+            return (uint64_t)k;
+
+        if (k < 0.0 || (us < 0.013 && V > us))
+            continue;
+
+        /* lgamma() writes the global signgam; lgamma_r() doesn't */
+        if (log(V) + log(invalp) - log(a / (us * us) + b) <=
+                -lambda + k * loglam - lgamma_r(k + 1.0, &sign))
+            return (uint64_t)k;
+    }
+}
+
+
+/*
+ * Public API.
+ */
+
+
+double
+arc4random_normal()
+{
+    struct words ws;
+    double v;
+
+    pthread_once(&Zonce, zcreate);
+    words_init(&ws, 1);
+    v = normal(&ws);
+    words_fini(&ws);
+
+    return v;
+}
+
+
+double
+arc4random_exponential()
+{
+    struct words ws;
+    double v;
+
+    pthread_once(&Zonce, zcreate);
+    words_init(&ws, 1);
+    v = exponential(&ws);
+    words_fini(&ws);
+
+    return v;
+}
+
+
+uint64_t
+arc4random_poisson(double lambda)
+{
+    struct words ws;
+    uint64_t v;
+
+    if (POISSON_BAD(lambda))
+        return 0;
+
+    words_init(&ws, 2);
+    v = poisson(&ws, lambda);
+    words_fini(&ws);
+
+    return v;
+}
+
+
+void
+arc4random_normal_fill(double* out, size_t n)
+{
+    struct words ws;
+    size_t i;
+
+    pthread_once(&Zonce, zcreate);
+    words_init(&ws, n);
+    for (i = 0; i < n; i++)
+        out[i] = normal(&ws);
+    words_fini(&ws);
+}
+
+
+void
+arc4random_exponential_fill(double* out, size_t n)
+{
+    struct words ws;
+    size_t i;
+
+    pthread_once(&Zonce, zcreate);
+    words_init(&ws, n);
+    for (i = 0; i < n; i++)
+        out[i] = exponential(&ws);
+    words_fini(&ws);
+}
+
+
+void
+arc4random_poisson_fill(uint64_t* out, size_t n, double lambda)
+{
+    struct words ws;
+    size_t i;
+
+    if (POISSON_BAD(lambda)) {
+        memset(out, 0, n * sizeof out[0]);
+        return;
+    }
+
+    words_init(&ws, 2 * n);
+    for (i = 0; i < n; i++)
+        out[i] = poisson(&ws, lambda);
+    words_fini(&ws);
+}
+
+/* EOF */
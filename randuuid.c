@@ -14,10 +14,32 @@
  * suitability for any purpose.
  */
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <assert.h>
+#include <pthread.h>
+#include <sys/time.h>
 
 #include "arc4random.h"
+#include "randuuid.h"
+#include "randuuid_hex.h"
+
+
+/*
+ * Per-thread version 7 state: the last timestamp handed out and the
+ * counter within that millisecond.
+ */
+struct uuid7_state
+{
+    uint64_t    ms;
+    uint32_t    ctr;
+};
+
+#define UUID7_CTR_MAX   0xfff
+
+/* Counter seeds leave half the counter space for the millisecond */
+#define UUID7_CTR_SEED  11
 
 
 /*
@@ -43,4 +65,223 @@ randuuid(uint8_t* b, size_t n)
         b[6] |= 0x40;
     }
 }
+
+
+#if defined(__Darwin__) || defined(__APPLE__)
+
+static pthread_key_t     U7key;
+static pthread_once_t    U7once = PTHREAD_ONCE_INIT;
+
+static void
+u7create()
+{
+    pthread_key_create(&U7key, free);
+}
+
+
+static struct uuid7_state*
+u7get()
+{
+    pthread_once(&U7once, u7create);
+
+    struct uuid7_state* z = (struct uuid7_state*)pthread_getspecific(U7key);
+    if (!z) {
+        z = (struct uuid7_state*)calloc(sizeof *z, 1);
+        assert(z);
+
+        pthread_setspecific(U7key, z);
+    }
+
+    return z;
+}
+
+#else
+
+static __thread struct uuid7_state U7 = { .ms = 0, .ctr = 0 };
+
+static inline struct uuid7_state*
+u7get()
+{
+    return &U7;
+}
+
+#endif /* __Darwin__ */
+
+
+static inline uint64_t
+now_ms()
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, 0);
+    return ((uint64_t)tv.tv_sec * 1000) + (tv.tv_usec / 1000);
+}
+
+
+/*
+ * Stamp the timestamp, counter, version and variant into 'b' which
+ * already holds random bytes. Advances the per-thread state.
+ */
+static inline void
+uuid7_fixup(struct uuid7_state* z, uint64_t now, uint8_t* b)
+{
+    if (now > z->ms) {
+        z->ms  = now;
+        z->ctr = arc4random_bits(UUID7_CTR_SEED);
+    } else if (++z->ctr > UUID7_CTR_MAX) {
+        /* counter exhausted; borrow from the next millisecond */
+        z->ms++;
+        z->ctr = arc4random_bits(UUID7_CTR_SEED);
+    }
+
+    b[0] = (uint8_t)(z->ms >> 40);
+    b[1] = (uint8_t)(z->ms >> 32);
+    b[2] = (uint8_t)(z->ms >> 24);
+    b[3] = (uint8_t)(z->ms >> 16);
+    b[4] = (uint8_t)(z->ms >> 8);
+    b[5] = (uint8_t)(z->ms);
+
+    b[6] = 0x70 | ((z->ctr >> 8) & 0x0f);
+    b[7] = (uint8_t)z->ctr;
+
+    b[8] &= 0x3f;
+    b[8] |= 0x80;
+}
+
+
+/*
+ * Generate a time ordered (version 7) UUID
+ *
+ * n should be at least  16 bytes long.
+ */
+void
+randuuid7(uint8_t* b, size_t n)
+{
+    uint8_t u[16];
+
+    if (n > 16) n = 16;
+
+    arc4random_buf(u + 8, 8);
+    uuid7_fixup(u7get(), now_ms(), u);
+    memcpy(b, u, n);
+}
+
+
+/*
+ * Generate 'nuuid' time ordered UUIDs with one clock read.
+ *
+ * Only the low 8 bytes of each UUID are random: they're drawn in one
+ * go into the back half of 'b' and spread out front to back. UUID
+ * i's bytes land at or before their source and past every source
+ * still to be read, so nothing is clobbered.
+ */
+void
+randuuid7_batch(uint8_t* b, size_t nuuid)
+{
+    struct uuid7_state* z = u7get();
+    uint64_t now = now_ms();
+    const uint8_t* r = b + nuuid * 8;
+    size_t i;
+
+    arc4random_buf(b + nuuid * 8, nuuid * 8);
+    for (i = 0; i < nuuid; i++, b += 16, r += 8) {
+        memmove(b + 8, r, 8);
+        uuid7_fixup(z, now, b);
+    }
+}
+
+
+/*
+ * Text form.
+ *
+ * The 32 hex digits are produced (or consumed) as one contiguous
+ * run and the dashes are placed with fixed size copies. With SSE2
+ * each half of the UUID is converted with a handful of vector ops.
+ */
+
+#define UUID_STRLEN     36
+
+#if defined(__SSE2__)
+#define uuid_hex        hex32_sse2
+#define uuid_unhex      unhex32_sse2
+#else
+#define uuid_hex        hex32
+#define uuid_unhex      unhex32
+#endif
+
+
+void
+randuuid_format(char* s, const uint8_t* b)
+{
+    char h[32];
+
+    uuid_hex(h, b);
+
+    memcpy(s,      h,      8);
+    s[8]  = '-';
+    memcpy(s + 9,  h + 8,  4);
+    s[13] = '-';
+    memcpy(s + 14, h + 12, 4);
+    s[18] = '-';
+    memcpy(s + 19, h + 16, 4);
+    s[23] = '-';
+    memcpy(s + 24, h + 20, 12);
+    s[36] = 0;
+}
+
+
+int
+randuuid_parse(uint8_t* b, const char* s)
+{
+    char h[32];
+
+    /* don't read past the end of a short string */
+    if (memchr(s, 0, UUID_STRLEN))
+        return -1;
+
+    if (s[8] != '-' || s[13] != '-' || s[18] != '-' || s[23] != '-')
+        return -1;
+
+    memcpy(h,      s,      8);
+    memcpy(h + 8,  s + 9,  4);
+    memcpy(h + 12, s + 14, 4);
+    memcpy(h + 16, s + 19, 4);
+    memcpy(h + 20, s + 24, 12);
+
+    return uuid_unhex(b, h);
+}
+
+
+void
+randuuid_str(char* s)
+{
+    uint8_t b[16];
+
+    randuuid(b, sizeof b);
+    randuuid_format(s, b);
+}
+
+
+void
+randuuid_format_batch(char* s, const uint8_t* b, size_t n)
+{
+    size_t i;
+
+    for (i = 0; i < n; i++, s += UUID_STRLEN + 1, b += 16)
+        randuuid_format(s, b);
+}
+
+
+size_t
+randuuid_parse_batch(uint8_t* b, const char* s, size_t n)
+{
+    size_t i;
+
+    for (i = 0; i < n; i++, s += UUID_STRLEN + 1, b += 16) {
+        if (randuuid_parse(b, s) < 0)
+            break;
+    }
+
+    return i;
+}
 /* EOF */
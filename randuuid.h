@@ -0,0 +1,107 @@
+/* vim: expandtab:tw=68:ts=4:sw=4:
+ *
+ * randuuid.h - UUID Generator based on Arc4Random
+ *
+ * Copyright (c) 2015 Sudhi Herle <sw at herle.net>
+ *
+ * Licensing Terms: GPLv2 
+ *
+ * If you need a commercial license for this work, please contact
+ * the author.
+ *
+ * This software does not come with any express or implied
+ * warranty; it is provided "as is". No claim  is made to its
+ * suitability for any purpose.
+ */
+
+#ifndef ___RANDUUID_H_7311842_1464124105__
+#define ___RANDUUID_H_7311842_1464124105__ 1
+
+    /* Provide C linkage for symbols declared here .. */
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include <stdint.h>
+#include <sys/types.h>
+
+
+/*
+ * Generate a random (version 4) UUID into 'b'. At most 16 bytes
+ * are written; 'n' should be at least 16.
+ */
+extern void randuuid(uint8_t* b, size_t n);
+
+
+/*
+ * Generate a time ordered (version 7) UUID into 'b'. At most 16
+ * bytes are written; 'n' should be at least 16.
+ *
+ * The UUID holds a 48-bit Unix timestamp in milliseconds, a 12-bit
+ * per-thread counter and 62 random bits. UUIDs minted by a thread
+ * are strictly increasing - even within the same millisecond or if
+ * the clock steps backwards.
+ */
+extern void randuuid7(uint8_t* b, size_t n);
+
+
+/*
+ * Generate 'nuuid' consecutive version 7 UUIDs into 'b' (which
+ * must have room for 16 * nuuid bytes). The clock is read once for
+ * the whole batch.
+ */
+extern void randuuid7_batch(uint8_t* b, size_t nuuid);
+
+
+/*
+ * Canonical text form of a UUID: 36 characters of lower case hex
+ * in 8-4-4-4-12 groups.
+ */
+
+/*
+ * Format the 16 byte UUID 'b' into 's'; writes 36 characters and a
+ * NUL (37 bytes).
+ */
+extern void randuuid_format(char* s, const uint8_t* b);
+
+
+/*
+ * Parse the UUID at the start of the string 's' into the 16 byte
+ * UUID 'b'. Upper and lower case hex digits are accepted. Reads no
+ * further than the first 36 characters or the terminating NUL,
+ * whichever comes first; anything after the 36th character is
+ * ignored. Returns 0 on success and -1 if 's' is shorter than 36
+ * characters or is not a well formed UUID.
+ */
+extern int randuuid_parse(uint8_t* b, const char* s);
+
+
+/*
+ * Generate a random (version 4) UUID in text form into 's' (37
+ * bytes).
+ */
+extern void randuuid_str(char* s);
+
+
+/*
+ * Format 'n' UUIDs from 'b' (16 * n bytes) into 's' as consecutive
+ * 37 byte NUL terminated strings.
+ */
+extern void randuuid_format_batch(char* s, const uint8_t* b, size_t n);
+
+
+/*
+ * Parse 'n' UUIDs from consecutive 37 byte records at 's' into 'b'.
+ * The 37th byte of each record (NUL, newline, ..) is ignored.
+ * Returns the number of UUIDs parsed before the first malformed
+ * one; 'n' on success.
+ */
+extern size_t randuuid_parse_batch(uint8_t* b, const char* s, size_t n);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* ! ___RANDUUID_H_7311842_1464124105__ */
+
+/* EOF */
@@ -0,0 +1,158 @@
+/* vim: expandtab:tw=68:ts=4:sw=4:
+ *
+ * randuuid_hex.h - Hex conversion kernels for the UUID text form
+ *
+ * Copyright (c) 2015 Sudhi Herle <sw at herle.net>
+ *
+ * Licensing Terms: GPLv2
+ *
+ * If you need a commercial license for this work, please contact
+ * the author.
+ *
+ * This software does not come with any express or implied
+ * warranty; it is provided "as is". No claim  is made to its
+ * suitability for any purpose.
+ */
+
+/*
+ * 16 bytes <-> 32 hex digits. hex32() writes lower case digits;
+ * unhex32() accepts either case and returns -1 (with 'b' left
+ * untouched) if any digit is invalid.
+ *
+ * The scalar kernels are always built; with SSE2 hex32_sse2() and
+ * unhex32_sse2() convert each half of the UUID with a handful of
+ * vector ops. Both produce identical results - t_kat checks them
+ * against each other.
+ */
+
+#ifndef __RANDUUID_HEX_H__
+#define __RANDUUID_HEX_H__ 1
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+
+static inline void
+hex32(char* h, const uint8_t* b)
+{
+    static const char hexdigits[] = "0123456789abcdef";
+    int i;
+
+    for (i = 0; i < 16; i++) {
+        h[2*i]   = hexdigits[b[i] >> 4];
+        h[2*i+1] = hexdigits[b[i] & 0x0f];
+    }
+}
+
+
+static inline int
+unhex(int c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    c |= 0x20;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+
+static inline int
+unhex32(uint8_t* b, const char* h)
+{
+    uint8_t v[16];
+    int i;
+
+    for (i = 0; i < 16; i++) {
+        int x = unhex((unsigned char)h[2*i]);
+        int y = unhex((unsigned char)h[2*i+1]);
+
+        if (x < 0 || y < 0)
+            return -1;
+        v[i] = (uint8_t)((x << 4) | y);
+    }
+
+    memcpy(b, v, sizeof v);
+    return 0;
+}
+
+
+#if defined(__SSE2__)
+
+/*
+ * 16 bytes -> 32 lower case hex digits.
+ */
+static inline void
+hex32_sse2(char* h, const uint8_t* b)
+{
+    const __m128i m0f = _mm_set1_epi8(0x0f);
+    const __m128i n9  = _mm_set1_epi8(9);
+    const __m128i a09 = _mm_set1_epi8('0');
+    const __m128i aaf = _mm_set1_epi8('a' - '0' - 10);
+    __m128i v  = _mm_loadu_si128((const __m128i*)b);
+    __m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), m0f);
+    __m128i lo = _mm_and_si128(v, m0f);
+    __m128i x0 = _mm_unpacklo_epi8(hi, lo);
+    __m128i x1 = _mm_unpackhi_epi8(hi, lo);
+
+    x0 = _mm_add_epi8(_mm_add_epi8(x0, a09), _mm_and_si128(_mm_cmpgt_epi8(x0, n9), aaf));
+    x1 = _mm_add_epi8(_mm_add_epi8(x1, a09), _mm_and_si128(_mm_cmpgt_epi8(x1, n9), aaf));
+
+    _mm_storeu_si128((__m128i*)h,        x0);
+    _mm_storeu_si128((__m128i*)(h + 16), x1);
+}
+
+
+/*
+ * 16 hex digits -> 8 bytes in the low half of the result; returns
+ * a mask with a bit set for each invalid digit. Bytes >= 0x80 are
+ * negative to the signed compares and fail both range tests.
+ */
+static inline int
+unhex16_sse2(__m128i c, __m128i* out)
+{
+    const __m128i n0  = _mm_set1_epi8('0' - 1);
+    const __m128i n9  = _mm_set1_epi8('9' + 1);
+    const __m128i na  = _mm_set1_epi8('a' - 1);
+    const __m128i nf  = _mm_set1_epi8('f' + 1);
+    const __m128i m0f = _mm_set1_epi8(0x0f);
+    const __m128i c20 = _mm_set1_epi8(0x20);
+    const __m128i c09 = _mm_set1_epi8(9);
+    const __m128i lf0 = _mm_set1_epi16(0x00f0);
+    __m128i l  = _mm_or_si128(c, c20);
+    __m128i d  = _mm_and_si128(_mm_cmpgt_epi8(c, n0), _mm_cmplt_epi8(c, n9));
+    __m128i a  = _mm_and_si128(_mm_cmpgt_epi8(l, na), _mm_cmplt_epi8(l, nf));
+
+    /* '0'-'9' -> 0-9; 'a'-'f' and 'A'-'F' -> 1-6 + 9 */
+    __m128i n  = _mm_add_epi8(_mm_and_si128(c, m0f), _mm_and_si128(a, c09));
+
+    /* each 16-bit lane holds two digits: high nibble in the low byte */
+    *out = _mm_or_si128(_mm_and_si128(_mm_slli_epi16(n, 4), lf0), _mm_srli_epi16(n, 8));
+
+    return 0xffff & ~_mm_movemask_epi8(_mm_or_si128(d, a));
+}
+
+
+/*
+ * 32 hex digits -> 16 bytes. Returns 0 if every digit is valid.
+ */
+static inline int
+unhex32_sse2(uint8_t* b, const char* h)
+{
+    __m128i x0, x1;
+    int bad;
+
+    bad  = unhex16_sse2(_mm_loadu_si128((const __m128i*)h), &x0);
+    bad |= unhex16_sse2(_mm_loadu_si128((const __m128i*)(h + 16)), &x1);
+    if (bad)
+        return -1;
+
+    _mm_storeu_si128((__m128i*)b, _mm_packus_epi16(x0, x1));
+    return 0;
+}
+
+#endif /* __SSE2__ */
+
+#endif /* __RANDUUID_HEX_H__ */
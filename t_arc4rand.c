@@ -3,9 +3,11 @@
  */
 #include <stdio.h>
 #include <stdlib.h>
+#include <inttypes.h>
 #include <errno.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <string.h>
 
 #include "arc4random.h"
 #include "cputime.h"
@@ -55,13 +57,314 @@ bench(int fd, size_t siz, size_t niter)
 
 
 
+/*
+ * Shuffle 'n' 32-bit ints with arc4random_shuffle() and with a
+ * naive Fisher-Yates loop over arc4random_uniform().
+ */
+static void
+bench_shuffle(size_t n, size_t niter)
+{
+    size_t i, j;
+    uint32_t *a = malloc(n * sizeof *a);
+    uint64_t s0, s1, s2;
+    uint64_t ta = 0;    // cumulative time for arc4random_shuffle
+    uint64_t tn = 0;    // cumulative time for naive loop
+
+    if (!a) error(1, errno, "Can't allocate %lu elements", n);
+    for (i = 0; i < n; i++) a[i] = i;
+
+    for (j = 0; j < niter; ++j) {
+        s0 = sys_cpu_timestamp();
+        arc4random_shuffle(a, n, sizeof a[0]);
+        s1 = sys_cpu_timestamp();
+        for (i = n - 1; i > 0; i--) {
+            uint32_t k = arc4random_uniform(i + 1);
+            uint32_t t = a[i];
+
+            a[i] = a[k];
+            a[k] = t;
+        }
+        s2 = sys_cpu_timestamp();
+
+        ta += s1 - s0;
+        tn += s2 - s1;
+    }
+
+    double sa = _d(ta) / _d(niter) / _d(n);   // cycles/element for arc4random_shuffle
+    double sn = _d(tn) / _d(niter) / _d(n);   // cycles/element for naive loop
+
+    printf("%9lu, %9.4f,\t%9.4f,\t%6.2f\n", n, sa, sn, sn / sa);
+
+    free(a);
+}
+
+
+/*
+ * Choose 'k' of 'n' indices with arc4random_sample_indices() and
+ * with a naive partial Fisher-Yates over an index array. The index
+ * array is set up once; each run's k swaps are undone outside the
+ * timed region so the naive loop costs O(k) like the real thing.
+ */
+static void
+bench_sample(size_t n, size_t k, size_t niter)
+{
+    size_t i, j;
+    size_t *out = malloc(k * sizeof *out);
+    size_t *swp = malloc(k * sizeof *swp);
+    size_t *idx = malloc(n * sizeof *idx);
+    uint64_t s0, s1, s2;
+    uint64_t ta = 0;    // cumulative time for arc4random_sample_indices
+    uint64_t tn = 0;    // cumulative time for naive loop
+
+    if (!out || !swp || !idx) error(1, errno, "Can't allocate %lu elements", n);
+
+    for (i = 0; i < n; i++) idx[i] = i;
+
+    for (j = 0; j < niter; ++j) {
+        s0 = sys_cpu_timestamp();
+        if (arc4random_sample_indices(n, k, out) < 0)
+            error(1, errno, "Can't sample %lu of %lu", k, n);
+        s1 = sys_cpu_timestamp();
+        for (i = 0; i < k; i++) {
+            size_t r = i + arc4random_uniform(n - i);
+            size_t t = idx[i];
+
+            idx[i] = idx[r];
+            idx[r] = t;
+            out[i] = idx[i];
+            swp[i] = r;
+        }
+        s2 = sys_cpu_timestamp();
+
+        /* back to the identity for the next run */
+        for (i = k; i-- > 0; ) {
+            size_t t = idx[i];
+
+            idx[i] = idx[swp[i]];
+            idx[swp[i]] = t;
+        }
+
+        ta += s1 - s0;
+        tn += s2 - s1;
+    }
+
+    double sa = _d(ta) / _d(niter) / _d(k);   // cycles/index for arc4random_sample_indices
+    double sn = _d(tn) / _d(niter) / _d(k);   // cycles/index for naive loop
+
+    printf("%9lu, %9lu, %9.4f,\t%9.4f,\t%6.2f\n", n, k, sa, sn, sn / sa);
+
+    free(idx);
+    free(swp);
+    free(out);
+}
+
+
+
+/*
+ * HDR style log-linear histogram of per-call latencies. Values below
+ * 2*HSUB are exact; above that every power of two is split into
+ * HSUB buckets - i.e., about 3% resolution.
+ */
+#define HBITS       5
+#define HSUB        (1 << HBITS)
+#define HBUCKETS    (2*HSUB + (64 - HBITS - 1) * HSUB)
+
+struct hist
+{
+    uint64_t n;
+    uint64_t max;
+    uint64_t b[HBUCKETS];
+};
+
+static inline unsigned
+hidx(uint64_t v)
+{
+    if (v < 2*HSUB) return v;
+
+    unsigned sh = 63 - __builtin_clzll(v) - HBITS;
+    return 2*HSUB + (sh - 1) * HSUB + (unsigned)(v >> sh) - HSUB;
+}
+
+/* highest value that lands in bucket 'i' */
+static uint64_t
+hval(unsigned i)
+{
+    if (i < 2*HSUB) return i;
+
+    unsigned sh  = (i - 2*HSUB) / HSUB + 1;
+    uint64_t top = (i - 2*HSUB) % HSUB + HSUB;
+    return ((top + 1) << sh) - 1;
+}
+
+static inline void
+hadd(struct hist* h, uint64_t v)
+{
+    h->b[hidx(v)]++;
+    h->n++;
+    if (v > h->max) h->max = v;
+}
+
+static uint64_t
+hpct(const struct hist* h, double q)
+{
+    uint64_t want = (uint64_t)(q * _d(h->n) + 0.5);
+    uint64_t sum  = 0;
+    unsigned i;
+
+    if (want == 0) want = 1;
+    for (i = 0; i < HBUCKETS; i++) {
+        sum += h->b[i];
+        if (sum >= want) {
+            uint64_t v = hval(i);
+            return v > h->max ? h->max : v;
+        }
+    }
+    return h->max;
+}
+
+/* number of samples in buckets above the one holding 'v' */
+static uint64_t
+habove(const struct hist* h, uint64_t v)
+{
+    uint64_t sum = 0;
+    unsigned i;
+
+    for (i = hidx(v) + 1; i < HBUCKETS; i++)
+        sum += h->b[i];
+    return sum;
+}
+
+
+/*
+ * Latencies of one kind of call; calls that refilled the keystream
+ * buffer or reseeded from getentropy() are also kept separately.
+ */
+struct lat
+{
+    struct hist all;
+    struct hist refill;
+    struct hist stir;
+};
+
+static volatile uint32_t Sink;
+
+#define LAT_RUN(lt, niter, call) do {                               \
+        struct arc4random_stats a0, a1;                             \
+        uint64_t t0, t1;                                            \
+        size_t j;                                                   \
+        for (j = 0; j < (niter); j++) {                             \
+            arc4random_stats(&a0);                                  \
+            t0 = sys_cpu_timestamp();                               \
+            call;                                                   \
+            t1 = sys_cpu_timestamp();                               \
+            arc4random_stats(&a1);                                  \
+            hadd(&(lt)->all, t1 - t0);                              \
+            if (a1.stirs != a0.stirs)                               \
+                hadd(&(lt)->stir, t1 - t0);                         \
+            else if (a1.refills != a0.refills)                      \
+                hadd(&(lt)->refill, t1 - t0);                       \
+        }                                                           \
+    } while (0)
+
+
+static void
+lat_print(const char* name, const struct lat* lt)
+{
+    uint64_t p99  = hpct(&lt->all, 0.99);
+    uint64_t nout = habove(&lt->all, p99);
+
+#define _pct(x)  (nout ? 100.0 * _d(x) / _d(nout) : 0.0)
+    printf("%-22s %9" PRIu64 ", %7" PRIu64 ", %7" PRIu64 ", %7" PRIu64 ", %9" PRIu64 "\n", name,
+            lt->all.n, hpct(&lt->all, 0.50), p99, hpct(&lt->all, 0.999), lt->all.max);
+    printf("    %-18s %9" PRIu64 ", %7" PRIu64 ", %7s, %7s, %9" PRIu64 "   %5.1f%% of >p99\n", "refill",
+            lt->refill.n, hpct(&lt->refill, 0.50), "-", "-", lt->refill.max,
+            _pct(habove(&lt->refill, p99)));
+    printf("    %-18s %9" PRIu64 ", %7" PRIu64 ", %7s, %7s, %9" PRIu64 "   %5.1f%% of >p99\n", "reseed",
+            lt->stir.n, hpct(&lt->stir, 0.50), "-", "-", lt->stir.max,
+            _pct(habove(&lt->stir, p99)));
+#undef _pct
+}
+
+
+/*
+ * Per-call latency of the scalar APIs and small arc4random_buf()
+ * sizes. The tail comes from rs_buf refills (every ~1 KiB of
+ * keystream) and reseeds (every 1.6 MB); those calls are reported
+ * separately along with their share of the calls above p99.
+ */
+static void
+bench_latency(size_t niter)
+{
+    static const size_t sizes[] = { 4, 16, 64, 256 };
+    struct lat* lt = malloc(sizeof *lt);
+    uint8_t buf[256];
+    char name[32];
+    size_t i;
+
+    if (!lt) error(1, errno, "Can't allocate histograms");
+
+    printf("ticks/call            calls,     p50,     p99,   p99.9,       max\n");
+
+    memset(lt, 0, sizeof *lt);
+    LAT_RUN(lt, niter, (void)0);
+    printf("%-22s %9s  %7" PRIu64 "\n", "(timer overhead)", "", hpct(&lt->all, 0.50));
+
+    memset(lt, 0, sizeof *lt);
+    LAT_RUN(lt, niter, Sink ^= arc4random());
+    lat_print("arc4random()", lt);
+
+    memset(lt, 0, sizeof *lt);
+    LAT_RUN(lt, niter, Sink ^= arc4random_uniform(1000));
+    lat_print("arc4random_uniform()", lt);
+
+    for (i = 0; i < sizeof sizes / sizeof sizes[0]; i++) {
+        memset(lt, 0, sizeof *lt);
+        LAT_RUN(lt, niter, arc4random_buf(buf, sizes[i]));
+        snprintf(name, sizeof name, "arc4random_buf(%lu)", sizes[i]);
+        lat_print(name, lt);
+    }
+    Sink ^= buf[0];
+
+    free(lt);
+}
+
+
+
 #define NITER       8192
+#define NITER_SHUF  16
+#define NITER_LAT   (1 << 21)
 
 int
 main(int argc, const char** argv)
 {
 
-    if (argc > 1) {
+    if (argc > 1 && 0 == strcmp(argv[1], "latency")) {
+        int n = argc > 2 ? atoi(argv[2]) : NITER_LAT;
+
+        if (n <= 0) error(1, 0, "Invalid iteration count %s\n", argv[2]);
+        bench_latency(n);
+    } else if (argc > 2 && 0 == strcmp(argv[1], "shuffle")) {
+        int i;
+
+        printf("     size,   shuffle,\t    naive,\tspeed-up\n");
+        for (i = 2; i < argc; ++i) {
+            int z = atoi(argv[i]);
+            if (z <= 0) continue;
+            bench_shuffle(z, NITER_SHUF);
+        }
+    } else if (argc > 3 && 0 == strcmp(argv[1], "sample")) {
+        int i;
+        int n = atoi(argv[2]);
+
+        if (n <= 0) error(1, 0, "Invalid population size %s\n", argv[2]);
+
+        printf("        n,         k,    sample,\t    naive,\tspeed-up\n");
+        for (i = 3; i < argc; ++i) {
+            int z = atoi(argv[i]);
+            if (z <= 0 || z > n) continue;
+            bench_sample(n, z, NITER_SHUF);
+        }
+    } else if (argc > 1) {
         int i;
 
         int fd = open("/dev/urandom", O_RDONLY);
@@ -0,0 +1,739 @@
+/*
+ * Known answer and differential tests for the ChaCha keystream
+ * kernels and the buffered generator.
+ *
+ *  - every kernel is checked against the RFC 8439 test vectors
+ *  - every kernel is compared with a straightforward one block at a
+ *    time reference over all lengths and output alignments, with a
+ *    fresh key and IV from /dev/urandom on every run
+ *  - the buffered generator, seeded from a deterministic
+ *    getentropy(), must reproduce a recorded digest of its output
+ *  - every UUID hex kernel is checked against a reference: round
+ *    trips, mixed case and every invalid byte at every position;
+ *    randuuid_format()/randuuid_parse() are checked for short
+ *    strings and misplaced dashes
+ *
+ * Run with -g to print the generator digest after an intentional
+ * change to the byte stream. The differential key is printed on
+ * every run; "-k HEX" repeats a run with that key.
+ */
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+
+#include "arc4random.h"
+#include "randuuid.h"
+#include "randuuid_hex.h"
+
+
+typedef struct
+{
+    uint32_t input[16];
+} chacha_ctx;
+
+#define KEYSTREAM_ONLY
+#include "chacha_private.h"
+
+/*
+ * The NEON kernel runs natively on little-endian AArch64 and, with
+ * the intrinsics from neon_emu.h, on other little-endian hosts - so
+ * it is tested everywhere.
+ */
+#if defined(__aarch64__) && defined(__ARM_NEON) && !defined(__AARCH64EB__)
+#define NEON_KERNEL     "neon"
+#elif defined(__GNUC__) && !defined(__aarch64__) && \
+      defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define NEON_KERNEL     "neon-emu"
+#endif
+
+#if defined(NEON_KERNEL)
+#include "chacha_neon.h"
+#endif
+
+
+typedef void (*kernel_fp)(chacha_ctx*, const u8*, u8*, u32);
+
+struct kernel
+{
+    const char* name;
+    kernel_fp   fp;
+};
+
+static const struct kernel Kernels[] = {
+    { "scalar", chacha_encrypt_bytes },
+#if defined(NEON_KERNEL)
+    { NEON_KERNEL, chacha_encrypt_bytes_neon },
+#endif
+};
+
+#define NKERNELS    (sizeof Kernels / sizeof Kernels[0])
+
+
+struct hex_kernel
+{
+    const char* name;
+    void (*hex)(char*, const uint8_t*);
+    int  (*unhex)(uint8_t*, const char*);
+};
+
+static const struct hex_kernel Hex_kernels[] = {
+    { "scalar", hex32,      unhex32 },
+#if defined(__SSE2__)
+    { "sse2",   hex32_sse2, unhex32_sse2 },
+#endif
+};
+
+#define NHEX_KERNELS    (sizeof Hex_kernels / sizeof Hex_kernels[0])
+
+
+/*
+ * Digest of the seeded generator's output; see gen_digest().
+ */
+#define GEN_DIGEST  0xd8e2a14fbd6f47f0ULL
+
+
+/* Key and IV sizes used by arc4random.c */
+#define KEYSZ       32
+#define IVSZ        8
+
+
+static int Fails = 0;
+
+
+/*
+ * Reference ChaCha20 block function - RFC 8439, section 2.3.
+ */
+static void
+ref_block(const uint32_t in[16], u8 out[64])
+{
+    uint32_t x[16];
+    int i;
+
+    memcpy(x, in, sizeof x);
+    for (i = 0; i < 10; i++) {
+        QUARTERROUND(x[0], x[4], x[ 8], x[12])
+        QUARTERROUND(x[1], x[5], x[ 9], x[13])
+        QUARTERROUND(x[2], x[6], x[10], x[14])
+        QUARTERROUND(x[3], x[7], x[11], x[15])
+        QUARTERROUND(x[0], x[5], x[10], x[15])
+        QUARTERROUND(x[1], x[6], x[11], x[12])
+        QUARTERROUND(x[2], x[7], x[ 8], x[13])
+        QUARTERROUND(x[3], x[4], x[ 9], x[14])
+    }
+
+    for (i = 0; i < 16; i++)
+        U32TO8_LITTLE(out + 4*i, PLUS(x[i], in[i]));
+}
+
+
+/*
+ * Reference keystream: whole blocks, truncating the last one.
+ * Advances the 64-bit block counter in input[12..13].
+ */
+static void
+ref_keystream(chacha_ctx* x, u8* c, size_t n)
+{
+    u8 blk[64];
+
+    while (n > 0) {
+        size_t m = n < 64 ? n : 64;
+
+        ref_block(x->input, blk);
+        memcpy(c, blk, m);
+        c += m;
+        n -= m;
+
+        if (!++x->input[12])
+            ++x->input[13];
+    }
+}
+
+
+/*
+ * RFC 8439 uses a 32-bit counter and a 96-bit nonce; in the
+ * original layout used here that is input[12] and input[13..15].
+ */
+static void
+rfc_setup(chacha_ctx* x, const u8 key[32], uint32_t ctr, const u8 nonce[12])
+{
+    chacha_keysetup(x, key, 256, 0);
+    x->input[12] = ctr;
+    x->input[13] = U8TO32_LITTLE(nonce + 0);
+    x->input[14] = U8TO32_LITTLE(nonce + 4);
+    x->input[15] = U8TO32_LITTLE(nonce + 8);
+}
+
+
+struct kat
+{
+    const char* name;
+    u8          key[32];
+    u8          nonce[12];
+    uint32_t    ctr;
+    u8          out[64];
+};
+
+static const struct kat Kats[] = {
+    {
+        "RFC 8439 2.3.2",
+        { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+          0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f,
+          0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17,
+          0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f },
+        { 0x00, 0x00, 0x00, 0x09, 0x00, 0x00, 0x00, 0x4a, 0x00, 0x00, 0x00, 0x00 },
+        1,
+        { 0x10, 0xf1, 0xe7, 0xe4, 0xd1, 0x3b, 0x59, 0x15, 0x50, 0x0f, 0xdd, 0x1f, 0xa3, 0x20, 0x71, 0xc4,
+          0xc7, 0xd1, 0xf4, 0xc7, 0x33, 0xc0, 0x68, 0x03, 0x04, 0x22, 0xaa, 0x9a, 0xc3, 0xd4, 0x6c, 0x4e,
+          0xd2, 0x82, 0x64, 0x46, 0x07, 0x9f, 0xaa, 0x09, 0x14, 0xc2, 0xd7, 0x05, 0xd9, 0x8b, 0x02, 0xa2,
+          0xb5, 0x12, 0x9c, 0xd1, 0xde, 0x16, 0x4e, 0xb9, 0xcb, 0xd0, 0x83, 0xe8, 0xa2, 0x50, 0x3c, 0x4e },
+    },
+    {
+        "RFC 8439 A.1 #1",
+        { 0 },
+        { 0 },
+        0,
+        { 0x76, 0xb8, 0xe0, 0xad, 0xa0, 0xf1, 0x3d, 0x90, 0x40, 0x5d, 0x6a, 0xe5, 0x53, 0x86, 0xbd, 0x28,
+          0xbd, 0xd2, 0x19, 0xb8, 0xa0, 0x8d, 0xed, 0x1a, 0xa8, 0x36, 0xef, 0xcc, 0x8b, 0x77, 0x0d, 0xc7,
+          0xda, 0x41, 0x59, 0x7c, 0x51, 0x57, 0x48, 0x8d, 0x77, 0x24, 0xe0, 0x3f, 0xb8, 0xd8, 0x4a, 0x37,
+          0x6a, 0x43, 0xb8, 0xf4, 0x15, 0x18, 0xa1, 0x1c, 0xc3, 0x87, 0xb6, 0x69, 0xb2, 0xee, 0x65, 0x86 },
+    },
+    {
+        "RFC 8439 A.1 #2",
+        { 0 },
+        { 0 },
+        1,
+        { 0x9f, 0x07, 0xe7, 0xbe, 0x55, 0x51, 0x38, 0x7a, 0x98, 0xba, 0x97, 0x7c, 0x73, 0x2d, 0x08, 0x0d,
+          0xcb, 0x0f, 0x29, 0xa0, 0x48, 0xe3, 0x65, 0x69, 0x12, 0xc6, 0x53, 0x3e, 0x32, 0xee, 0x7a, 0xed,
+          0x29, 0xb7, 0x21, 0x76, 0x9c, 0xe6, 0x4e, 0x43, 0xd5, 0x71, 0x33, 0xb0, 0x74, 0xd8, 0x39, 0xd5,
+          0x31, 0xed, 0x1f, 0x28, 0x51, 0x0a, 0xfb, 0x45, 0xac, 0xe1, 0x0a, 0x1f, 0x4b, 0x79, 0x4d, 0x6f },
+    },
+    {
+        "RFC 8439 A.1 #3",
+        { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+          0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1 },
+        { 0 },
+        1,
+        { 0x3a, 0xeb, 0x52, 0x24, 0xec, 0xf8, 0x49, 0x92, 0x9b, 0x9d, 0x82, 0x8d, 0xb1, 0xce, 0xd4, 0xdd,
+          0x83, 0x20, 0x25, 0xe8, 0x01, 0x8b, 0x81, 0x60, 0xb8, 0x22, 0x84, 0xf3, 0xc9, 0x49, 0xaa, 0x5a,
+          0x8e, 0xca, 0x00, 0xbb, 0xb4, 0xa7, 0x3b, 0xda, 0xd1, 0x92, 0xb5, 0xc4, 0x2f, 0x73, 0xf2, 0xfd,
+          0x4e, 0x27, 0x36, 0x44, 0xc8, 0xb3, 0x61, 0x25, 0xa6, 0x4a, 0xdd, 0xeb, 0x00, 0x6c, 0x13, 0xa0 },
+    },
+    {
+        "RFC 8439 A.1 #4",
+        { 0, 0xff },
+        { 0 },
+        2,
+        { 0x72, 0xd5, 0x4d, 0xfb, 0xf1, 0x2e, 0xc4, 0x4b, 0x36, 0x26, 0x92, 0xdf, 0x94, 0x13, 0x7f, 0x32,
+          0x8f, 0xea, 0x8d, 0xa7, 0x39, 0x90, 0x26, 0x5e, 0xc1, 0xbb, 0xbe, 0xa1, 0xae, 0x9a, 0xf0, 0xca,
+          0x13, 0xb2, 0x5a, 0xa2, 0x6c, 0xb4, 0xa6, 0x48, 0xcb, 0x9b, 0x9d, 0x1b, 0xe6, 0x5b, 0x2c, 0x09,
+          0x24, 0xa6, 0x6c, 0x54, 0xd5, 0x45, 0xec, 0x1b, 0x73, 0x74, 0xf4, 0x87, 0x2e, 0x99, 0xf0, 0x96 },
+    },
+    {
+        "RFC 8439 A.1 #5",
+        { 0 },
+        { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2 },
+        0,
+        { 0xc2, 0xc6, 0x4d, 0x37, 0x8c, 0xd5, 0x36, 0x37, 0x4a, 0xe2, 0x04, 0xb9, 0xef, 0x93, 0x3f, 0xcd,
+          0x1a, 0x8b, 0x22, 0x88, 0xb3, 0xdf, 0xa4, 0x96, 0x72, 0xab, 0x76, 0x5b, 0x54, 0xee, 0x27, 0xc7,
+          0x8a, 0x97, 0x0e, 0x0e, 0x95, 0x5c, 0x14, 0xf3, 0xa8, 0x8e, 0x74, 0x1b, 0x97, 0xc2, 0x86, 0xf7,
+          0x5f, 0x8f, 0xc2, 0x99, 0xe8, 0x14, 0x83, 0x62, 0xfa, 0x19, 0x8a, 0x39, 0x53, 0x1b, 0xed, 0x6d },
+    },
+};
+
+
+static void
+check(int ok, const char* fmt, ...)
+{
+    va_list ap;
+
+    if (ok) return;
+
+    Fails++;
+    printf("FAIL: ");
+    va_start(ap, fmt);
+    vprintf(fmt, ap);
+    va_end(ap);
+    printf("\n");
+}
+
+
+/*
+ * Known answers. Each kernel is asked for several blocks so that
+ * multi-block kernels run their wide path; the first block must
+ * match the vector and the rest must match the reference.
+ */
+static void
+test_kat()
+{
+    size_t i, k;
+
+    for (i = 0; i < sizeof Kats / sizeof Kats[0]; i++) {
+        const struct kat* t = &Kats[i];
+        chacha_ctx r;
+        u8 ref[1024];
+
+        rfc_setup(&r, t->key, t->ctr, t->nonce);
+        ref_keystream(&r, ref, sizeof ref);
+        check(0 == memcmp(ref, t->out, 64), "%s: reference", t->name);
+
+        for (k = 0; k < NKERNELS; k++) {
+            chacha_ctx x;
+            u8 out[1024];
+
+            rfc_setup(&x, t->key, t->ctr, t->nonce);
+            Kernels[k].fp(&x, out, out, sizeof out);
+            check(0 == memcmp(out, t->out, 64), "%s: %s", t->name, Kernels[k].name);
+            check(0 == memcmp(out, ref, sizeof out), "%s: %s multi-block", t->name, Kernels[k].name);
+            check(0 == memcmp(x.input, r.input, sizeof x.input), "%s: %s counter", t->name, Kernels[k].name);
+        }
+    }
+}
+
+
+/*
+ * Key and IV for the differential tests: parsed from 'hex' if
+ * given, else from /dev/urandom (the generator under test can't
+ * supply it - its getentropy() is deterministic here). Falls back
+ * to the clock and pid if /dev/urandom can't be read.
+ */
+static int
+diff_key(u8 key[KEYSZ + IVSZ], const char* hex)
+{
+    size_t i;
+    int fd;
+
+    if (hex) {
+        if (strlen(hex) != 2 * (KEYSZ + IVSZ))
+            return -1;
+
+        for (i = 0; i < KEYSZ + IVSZ; i++) {
+            int x = unhex((unsigned char)hex[2*i]);
+            int y = unhex((unsigned char)hex[2*i+1]);
+
+            if (x < 0 || y < 0)
+                return -1;
+            key[i] = (u8)((x << 4) | y);
+        }
+        return 0;
+    }
+
+    fd = open("/dev/urandom", O_RDONLY);
+    if (fd < 0 || read(fd, key, KEYSZ + IVSZ) != KEYSZ + IVSZ) {
+        uint64_t z = ((uint64_t)time(0) << 20) ^ (uint64_t)getpid() ^ 0x9e3779b97f4a7c15ULL;
+
+        for (i = 0; i < KEYSZ + IVSZ; i++) {
+            z = z * 6364136223846793005ULL + 1442695040888963407ULL;
+            key[i] = (u8)(z >> 56);
+        }
+    }
+    if (fd >= 0)
+        close(fd);
+    return 0;
+}
+
+
+/*
+ * Differential: every kernel vs. the reference for every length up
+ * to MAXLEN and every output alignment, starting from counters that
+ * are about to carry into input[13].
+ */
+#define MAXLEN      (1024 + 320)
+#define MAXALIGN    16
+
+static void
+test_diff(const u8 key[KEYSZ + IVSZ])
+{
+    static const uint32_t ctrs[] = { 0, 1, 0xfffffffd, 0xffffffff };
+    u8 *ref = malloc(MAXLEN);
+    u8 *buf = malloc(MAXLEN + MAXALIGN + 1);
+    size_t k, c, n, a;
+
+    for (k = 0; k < NKERNELS; k++) {
+        for (c = 0; c < sizeof ctrs / sizeof ctrs[0]; c++) {
+            for (n = 0; n <= MAXLEN; n++) {
+                chacha_ctx r0, r, x;
+
+                chacha_keysetup(&r0, key, 256, 0);
+                chacha_ivsetup(&r0, key + KEYSZ);
+                r0.input[12] = ctrs[c];
+                r0.input[13] = (uint32_t)c;
+
+                r = r0;
+                ref_keystream(&r, ref, n);
+
+                for (a = 0; a < MAXALIGN; a++) {
+                    u8* out = buf + a;
+
+                    x = r0;
+                    memset(buf, 0xa5, MAXLEN + MAXALIGN + 1);
+                    Kernels[k].fp(&x, out, out, n);
+
+                    check(0 == memcmp(out, ref, n),
+                          "%s: ctr %#x len %lu align %lu: keystream", Kernels[k].name, ctrs[c], n, a);
+                    check(out[n] == 0xa5 && (a == 0 || out[-1] == 0xa5),
+                          "%s: ctr %#x len %lu align %lu: overrun", Kernels[k].name, ctrs[c], n, a);
+
+                    check(0 == memcmp(x.input, r.input, sizeof x.input),
+                          "%s: ctr %#x len %lu align %lu: counter", Kernels[k].name, ctrs[c], n, a);
+                    if (Fails > 16) goto out;
+                }
+            }
+        }
+    }
+
+out:
+    free(buf);
+    free(ref);
+}
+
+
+/*
+ * Reference hex conversions.
+ */
+static void
+ref_hex32(char* h, const uint8_t* b)
+{
+    int i;
+
+    for (i = 0; i < 16; i++)
+        sprintf(h + 2*i, "%02x", b[i]);
+}
+
+
+static int
+ref_digit(unsigned char c)
+{
+    static const char lc[] = "0123456789abcdef";
+    static const char uc[] = "0123456789ABCDEF";
+    int i;
+
+    for (i = 0; i < 16; i++) {
+        if (c == (unsigned char)lc[i] || c == (unsigned char)uc[i])
+            return i;
+    }
+    return -1;
+}
+
+
+static int
+ref_unhex32(uint8_t* b, const char* h)
+{
+    int i;
+
+    for (i = 0; i < 32; i++) {
+        if (ref_digit(h[i]) < 0)
+            return -1;
+    }
+    for (i = 0; i < 16; i++)
+        b[i] = (uint8_t)(ref_digit(h[2*i]) << 4 | ref_digit(h[2*i+1]));
+    return 0;
+}
+
+
+/*
+ * Test patterns for the UUID tests; independent of arc4random so
+ * the generator digest doesn't depend on test order.
+ */
+static uint64_t
+xorshift(uint64_t* s)
+{
+    *s ^= *s << 13;
+    *s ^= *s >> 7;
+    *s ^= *s << 17;
+    return *s;
+}
+
+
+static void
+pattern(uint8_t b[16], size_t i, uint64_t* s)
+{
+    size_t j;
+
+    /* every byte value at every position first, then noise */
+    for (j = 0; j < 16; j++)
+        b[j] = i < 256 ? (uint8_t)(i + 97 * j) : (uint8_t)xorshift(s);
+}
+
+
+static void
+test_hex()
+{
+    uint64_t seed = 0x9e3779b97f4a7c15ULL;
+    uint8_t  b[16], v[16], r[16];
+    char     h[33], rh[33], m[32];
+    size_t   k, i, j;
+    int      c;
+
+    for (k = 0; k < NHEX_KERNELS; k++) {
+        const struct hex_kernel* hk = &Hex_kernels[k];
+
+        for (i = 0; i < 4096; i++) {
+            pattern(b, i, &seed);
+
+            hk->hex(h, b);
+            ref_hex32(rh, b);
+            check(0 == memcmp(h, rh, 32), "%s: hex32 #%lu: %.32s, expected %.32s", hk->name, i, h, rh);
+
+            check(0 == hk->unhex(v, h) && 0 == memcmp(v, b, 16), "%s: unhex32 #%lu: round trip", hk->name, i);
+
+            /* mixed case; a different mask each time */
+            for (j = 0; j < 32; j++)
+                m[j] = (xorshift(&seed) & 1) && h[j] >= 'a' ? h[j] - 'a' + 'A' : h[j];
+            check(0 == hk->unhex(v, m) && 0 == memcmp(v, b, 16), "%s: unhex32 #%lu: mixed case %.32s", hk->name, i, m);
+        }
+
+        /* every invalid byte at every position; output left alone */
+        pattern(b, 4096, &seed);
+        ref_hex32(rh, b);
+        for (c = 0; c < 256; c++) {
+            if (ref_digit(c) >= 0)
+                continue;
+
+            for (j = 0; j < 32; j++) {
+                memcpy(m, rh, 32);
+                m[j] = (char)c;
+                memset(v, 0xa5, 16);
+                memset(r, 0xa5, 16);
+
+                check(-1 == ref_unhex32(r, m), "ref: accepted %#x at %lu", c, j);
+                check(-1 == hk->unhex(v, m) && 0 == memcmp(v, r, 16),
+                      "%s: unhex32: accepted %#x at %lu", hk->name, c, j);
+            }
+        }
+    }
+}
+
+
+static void
+test_uuid_text()
+{
+    static const size_t dash[] = { 8, 13, 18, 23 };
+    uint64_t seed = 0x2545f4914f6cdd1dULL;
+    uint8_t  b[16], v[16], vb[4 * 16];
+    char     s[37], t[37], batch[4 * 37];
+    size_t   i, j, d;
+
+    for (i = 0; i < 1024; i++) {
+        pattern(b, i, &seed);
+        randuuid_format(s, b);
+
+        check(strlen(s) == 36 && s[8] == '-' && s[13] == '-' && s[18] == '-' && s[23] == '-',
+              "randuuid_format #%lu: %s", i, s);
+        check(0 == randuuid_parse(v, s) && 0 == memcmp(v, b, 16), "randuuid_parse #%lu: %s", i, s);
+
+        for (j = 0; j < 36; j++)
+            t[j] = s[j] >= 'a' && s[j] <= 'f' ? s[j] - 'a' + 'A' : s[j];
+        t[36] = 0;
+        check(0 == randuuid_parse(v, t) && 0 == memcmp(v, b, 16), "randuuid_parse #%lu: %s", i, t);
+    }
+
+    /* short strings, each in an allocation of exactly its size */
+    for (i = 0; i < 36; i++) {
+        char* p = malloc(i + 1);
+
+        memcpy(p, s, i);
+        p[i] = 0;
+        check(-1 == randuuid_parse(v, p), "randuuid_parse: accepted %lu chars", i);
+        free(p);
+    }
+
+    /* trailing characters are ignored */
+    memcpy(t, s, 36);
+    t[36] = 'x';
+    check(0 == randuuid_parse(v, t), "randuuid_parse: rejected trailing byte");
+
+    /* a dash anywhere else, or a digit where a dash belongs */
+    for (j = 0; j < 36; j++) {
+        int isdash = 0;
+
+        for (d = 0; d < 4; d++)
+            isdash |= j == dash[d];
+
+        memcpy(t, s, 37);
+        t[j] = isdash ? '0' : '-';
+        check(-1 == randuuid_parse(v, t), "randuuid_parse: accepted %s", t);
+    }
+
+    /* batches stop at the first bad record */
+    for (i = 0; i < 4; i++) {
+        pattern(b, i, &seed);
+        randuuid_format(batch + i * 37, b);
+    }
+    check(4 == randuuid_parse_batch(vb, batch, 4), "randuuid_parse_batch: 4 records");
+    batch[2 * 37 + 5] = 'g';
+    check(2 == randuuid_parse_batch(vb, batch, 4), "randuuid_parse_batch: bad record");
+}
+
+
+/*
+ * Deterministic entropy for the seeded generator test. Each request
+ * for a full key + IV is filled from a counter; smaller requests
+ * (the one time warm-up on Darwin) don't advance the sequence.
+ */
+static uint32_t Gen = 0;
+
+int
+getentropy(void* buf, size_t n)
+{
+    u8* b = (u8 *)buf;
+    size_t i;
+
+    for (i = 0; i < n; i++)
+        b[i] = (u8)(i * 13 + Gen * 101 + 7);
+
+    if (n >= KEYSZ + IVSZ)
+        Gen++;
+    return 0;
+}
+
+
+static uint64_t
+fnv(uint64_t h, const void* p, size_t n)
+{
+    const u8* b = (const u8 *)p;
+
+    while (n-- > 0) {
+        h ^= *b++;
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+
+/*
+ * Hash 'v' as 8 little-endian bytes so the digest doesn't depend
+ * on the host's byte order or word sizes.
+ */
+static uint64_t
+fnv_u64(uint64_t h, uint64_t v)
+{
+    u8 b[8];
+    int i;
+
+    for (i = 0; i < 8; i++, v >>= 8)
+        b[i] = (u8)v;
+    return fnv(h, b, sizeof b);
+}
+
+
+/*
+ * Drive the generator through every public entry point - enough
+ * output to go through many rekeys and a couple of reseeds - and
+ * return a digest of everything it produced.
+ */
+static uint64_t
+gen_digest()
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    u8 *buf = malloc(8192);
+    uint32_t a[64];
+    size_t idx[64];
+    char tok[64];
+    size_t i, n;
+
+    for (i = 0; i < 512; i++) {
+        uint32_t v[6];
+
+        v[0] = arc4random();
+        v[1] = arc4random_uniform(1000003);
+        v[2] = arc4random_bit();
+        v[3] = arc4random_bits(i % 33);
+        v[4] = arc4random_bool(i + 1, 1001);
+        v[5] = arc4random_bits(32);
+        for (n = 0; n < 6; n++) h = fnv_u64(h, v[n]);
+
+        n = (i * 37) % 8192;
+        arc4random_buf(buf, n);
+        h = fnv(h, buf, n);
+
+        for (n = 0; n < 64; n++) a[n] = n;
+        arc4random_shuffle(a, 64, sizeof a[0]);
+        for (n = 0; n < 64; n++) h = fnv_u64(h, a[n]);
+
+        arc4random_sample_indices(1000, 1 + i % 64, idx);
+        for (n = 0; n < 1 + i % 64; n++) h = fnv_u64(h, idx[n]);
+
+        arc4random_token(tok, i % 63, (enum arc4random_encoding)(i % 3));
+        h = fnv(h, tok, i % 63);
+    }
+
+    /* cross a couple of reseed boundaries */
+    for (i = 0; i < 512; i++) {
+        arc4random_buf(buf, 8192);
+        h = fnv(h, buf, 8192);
+    }
+
+    free(buf);
+    return h;
+}
+
+
+static void
+test_gen(int print)
+{
+    uint64_t h = gen_digest();
+
+    if (print) {
+        printf("generator digest: %#018llx\n", (unsigned long long)h);
+        return;
+    }
+
+    check(h == GEN_DIGEST, "seeded generator digest %#018llx, expected %#018llx",
+          (unsigned long long)h, (unsigned long long)GEN_DIGEST);
+}
+
+
+int
+main(int argc, const char** argv)
+{
+    u8 key[KEYSZ + IVSZ];
+    const char* hex = 0;
+    size_t k;
+
+    if (argc > 1 && 0 == strcmp(argv[1], "-g")) {
+        test_gen(1);
+        return 0;
+    }
+
+    if (argc > 2 && 0 == strcmp(argv[1], "-k"))
+        hex = argv[2];
+    else if (argc > 1) {
+        fprintf(stderr, "Usage: %s [-g | -k HEX]\n", argv[0]);
+        return 2;
+    }
+
+    if (diff_key(key, hex) < 0) {
+        fprintf(stderr, "%s: key must be %d hex digits\n", argv[0], 2 * (KEYSZ + IVSZ));
+        return 2;
+    }
+
+    printf("differential key: ");
+    for (k = 0; k < KEYSZ + IVSZ; k++)
+        printf("%02x", key[k]);
+    printf("\n");
+
+    /* generator first - it must see the entropy sequence from the start */
+    test_gen(0);
+    test_kat();
+    test_diff(key);
+    test_hex();
+    test_uuid_text();
+
+    printf("kernels:");
+    for (k = 0; k < NKERNELS; k++)
+        printf(" %s", Kernels[k].name);
+    printf("\nhex kernels:");
+    for (k = 0; k < NHEX_KERNELS; k++)
+        printf(" %s", Hex_kernels[k].name);
+    printf("\n%s\n", Fails ? "FAILED" : "PASS");
+
+    return Fails ? 1 : 0;
+}
+
+/* EOF */
@@ -0,0 +1,36 @@
+/* vim: expandtab:tw=68:ts=4:sw=4:
+ *
+ * wipe.h - Zero memory in a way the compiler can't optimize away
+ *
+ * Copyright (c) 2015 Sudhi Herle <sw at herle.net>
+ *
+ * Licensing Terms: GPLv2
+ *
+ * If you need a commercial license for this work, please contact
+ * the author.
+ *
+ * This software does not come with any express or implied
+ * warranty; it is provided "as is". No claim  is made to its
+ * suitability for any purpose.
+ */
+
+#ifndef __WIPE_H__
+#define __WIPE_H__ 1
+
+#include <string.h>
+
+/*
+ * Clearing a buffer that is about to go out of scope (or be freed)
+ * is a dead store as far as the compiler is concerned. Calling
+ * memset() through a volatile function pointer hides the callee, so
+ * the call - and the stores - must be kept.
+ */
+static inline void
+wipe(void* p, size_t n)
+{
+    static void* (* const volatile wipe_fp)(void*, int, size_t) = memset;
+
+    wipe_fp(p, 0, n);
+}
+
+#endif /* __WIPE_H__ */